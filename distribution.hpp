@@ -0,0 +1,479 @@
+#pragma once
+/**
+ * @file
+ * @brief Access distributions of block ids.
+ */
+#include <cinttypes>
+#include <cstddef>
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <stdexcept>
+#include "string_util.hpp"
+#include "rand.hpp"
+
+
+enum DistType
+{
+    DIST_UNIFORM, DIST_ZIPF, DIST_PARETO, DIST_NORMAL, DIST_HOTCOLD, DIST_PERM, DIST_SEQ,
+};
+
+/**
+ * Configuration of an access distribution.
+ */
+struct DistConfig
+{
+    DistType type;
+    double param1; /* zipf: theta, pareto: h, normal: sigma [%], hotcold: IOs [%]. */
+    double param2; /* normal: center [%], hotcold: blocks [%]. */
+
+    DistConfig() : type(DIST_UNIFORM), param1(0), param2(0) {}
+
+    /**
+     * @s one of uniform, perm, seq, zipf:theta, pareto:h, normal:sigma[:center],
+     *    and hotcold:ios:blocks.
+     */
+    void set(const std::string& s) {
+        std::vector<std::string> v = splitString(s, ':');
+        const std::string& name = v[0];
+        std::vector<double> params;
+        for (size_t i = 1; i < v.size(); i++) {
+            params.push_back(::atof(v[i].c_str()));
+        }
+        if (name == "uniform" && params.empty()) {
+            type = DIST_UNIFORM;
+        } else if (name == "perm" && params.empty()) {
+            type = DIST_PERM;
+        } else if (name == "seq" && params.empty()) {
+            type = DIST_SEQ;
+        } else if (name == "zipf" && params.size() == 1) {
+            type = DIST_ZIPF;
+            param1 = params[0];
+            if (param1 <= 0) {
+                throw std::runtime_error("zipf theta must be positive.");
+            }
+        } else if (name == "pareto" && params.size() == 1) {
+            type = DIST_PARETO;
+            param1 = params[0];
+            if (param1 <= 0 || param1 >= 0.5) {
+                throw std::runtime_error("pareto h must be between 0 and 0.5.");
+            }
+        } else if (name == "normal" && (params.size() == 1 || params.size() == 2)) {
+            type = DIST_NORMAL;
+            param1 = params[0];
+            param2 = params.size() == 2 ? params[1] : 50.0;
+            if (param1 <= 0 || param2 < 0 || param2 > 100) {
+                throw std::runtime_error("normal sigma must be positive and center must be between 0 and 100.");
+            }
+        } else if (name == "hotcold" && params.size() == 2) {
+            type = DIST_HOTCOLD;
+            param1 = params[0];
+            param2 = params[1];
+            if (param1 < 0 || param1 > 100 || param2 <= 0 || param2 >= 100) {
+                throw std::runtime_error("hotcold percentages must be between 0 and 100.");
+            }
+        } else {
+            throw std::runtime_error(formatString("bad distribution: %s", s.c_str()));
+        }
+    }
+
+    bool isUniform() const { return type == DIST_UNIFORM; }
+
+    /**
+     * @return true if each user should have its own partition by setPartition().
+     */
+    bool isPartitioned() const { return type == DIST_PERM || type == DIST_SEQ; }
+
+    /**
+     * @return true if the accessed blocks are known by construction,
+     *   so that they need not be recorded.
+     */
+    bool isCoverageKnown() const { return type == DIST_PERM || type == DIST_SEQ; }
+};
+
+/**
+ * Generator of block ids in [0, n) following a distribution.
+ *
+ * zipf uses rejection-inversion sampling (Hormann and Derflinger),
+ * which needs O(1) time per sample and no table for any n and theta.
+ * pareto is the self-similar distribution by Gray et al.,
+ * where 1 - h of IOs go to h of the blocks.
+ * zipf and pareto ranks are scattered over the range by a multiplicative
+ * permutation, so hot blocks are not adjacent.
+ * perm visits each block exactly once per pass in a pseudo-random order.
+ * It uses a Feistel network with cycle walking, which needs O(1) memory.
+ * Every pass uses the same permutation, so partitions never overlap
+ * even while their users are in different passes.
+ * seq visits blocks in ascending order and wraps around.
+ * get() takes block ids from a batch made by fill() to keep the per-IO cost low.
+ */
+class BlockDistribution
+{
+private:
+    const DistConfig cfg_;
+    const uint64_t n_;
+    Xoshiro256 gen_;
+    std::vector<uint64_t> batch_;
+    size_t batchIdx_;
+    uint64_t mult_; /* coprime to n_ to scatter ranks. */
+
+    /* zipf */
+    double hIntegralX1_;
+    double hIntegralN_;
+    double s_;
+
+    /* pareto */
+    double paretoExp_;
+
+    /* normal */
+    bool hasSpare_;
+    double spare_;
+
+    /* hotcold */
+    uint64_t nrHot_;
+
+    /* perm */
+    uint64_t permSeed_; /* shared by the partitions. */
+    unsigned halfBits_; /* the permutation domain is 2^(halfBits_ * 2). */
+    uint64_t halfMask_;
+    uint64_t roundKeys_[4];
+    uint64_t partBgn_, partEnd_; /* partition of the indexes in a pass. */
+    uint64_t permIdx_;
+
+public:
+    /**
+     * @gen generator which should be an independent stream for each user.
+     */
+    BlockDistribution(const DistConfig& cfg, uint64_t n, const Xoshiro256& gen)
+        : cfg_(cfg), n_(n), gen_(gen), batch_(256), batchIdx_(256), mult_(1)
+        , hIntegralX1_(0), hIntegralN_(0), s_(0)
+        , paretoExp_(0)
+        , hasSpare_(false), spare_(0)
+        , nrHot_(0)
+        , permSeed_(0), halfBits_(1), halfMask_(1), roundKeys_()
+        , partBgn_(0), partEnd_(n), permIdx_(0) {
+
+        if (n_ == 0) {
+            throw std::runtime_error("BlockDistribution: empty range.");
+        }
+        mult_ = findCoprime(n_);
+        switch (cfg_.type) {
+        case DIST_ZIPF:
+            hIntegralX1_ = hIntegral(1.5) - 1.0;
+            hIntegralN_ = hIntegral(static_cast<double>(n_) + 0.5);
+            s_ = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+            break;
+        case DIST_PARETO:
+            paretoExp_ = std::log(cfg_.param1) / std::log(1.0 - cfg_.param1);
+            break;
+        case DIST_HOTCOLD:
+            nrHot_ = std::max<uint64_t>(1, static_cast<uint64_t>(n_ * cfg_.param2 / 100.0));
+            nrHot_ = std::min(nrHot_, n_);
+            break;
+        case DIST_PERM:
+            while ((uint64_t(1) << (halfBits_ * 2)) < n_) halfBits_++;
+            halfMask_ = (uint64_t(1) << halfBits_) - 1;
+            setRoundKeys();
+            break;
+        default:
+            break;
+        }
+    }
+
+    /**
+     * Split each pass of perm, or the range of seq, into nr partitions
+     * and use the idx-th one.
+     * The partitions do not overlap if they are made with the same seed.
+     */
+    void setPartition(uint64_t seed, size_t idx, size_t nr) {
+        assert(idx < nr);
+        if (nr > n_) {
+            throw std::runtime_error("access range is too small for the partitions.");
+        }
+        permSeed_ = seed;
+        partBgn_ = static_cast<unsigned __int128>(n_) * idx / nr;
+        partEnd_ = static_cast<unsigned __int128>(n_) * (idx + 1) / nr;
+        permIdx_ = partBgn_;
+        setRoundKeys();
+    }
+
+    /**
+     * @return a block id in [0, n).
+     */
+    uint64_t get() {
+        if (batchIdx_ == batch_.size()) {
+            fill(&batch_[0], batch_.size());
+            batchIdx_ = 0;
+        }
+        return batch_[batchIdx_++];
+    }
+
+    /**
+     * Fill an array with block ids in [0, n).
+     */
+    void fill(uint64_t *v, size_t nr) {
+        if (cfg_.type == DIST_UNIFORM) {
+            gen_.fill(v, nr, n_);
+            return;
+        }
+        for (size_t i = 0; i < nr; i++) {
+            v[i] = getOne();
+        }
+    }
+
+private:
+    uint64_t getOne() {
+        switch (cfg_.type) {
+        case DIST_PERM:
+            return getPermuted();
+        case DIST_SEQ:
+            return getSequential();
+        case DIST_ZIPF:
+            return scatter(getZipfRank());
+        case DIST_PARETO:
+            return scatter(std::min(n_ - 1, static_cast<uint64_t>(
+                                        n_ * std::pow(getDouble(), paretoExp_))));
+        case DIST_NORMAL:
+            return getNormal();
+        case DIST_HOTCOLD:
+            if (nrHot_ == n_ || getDouble() * 100.0 < cfg_.param1) {
+                return getUniform(nrHot_);
+            }
+            return nrHot_ + getUniform(n_ - nrHot_);
+        default:
+            return getUniform(n_);
+        }
+    }
+
+    double getDouble() { return gen_.getDouble(); }
+
+    uint64_t getSequential() {
+        const uint64_t id = permIdx_++;
+        if (permIdx_ == partEnd_) permIdx_ = partBgn_;
+        return id;
+    }
+    uint64_t getUniform(uint64_t max) { return gen_.get(max); }
+
+    static uint64_t gcd(uint64_t a, uint64_t b) {
+        while (b != 0) {
+            uint64_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+    static uint64_t findCoprime(uint64_t n) {
+        if (n <= 2) return 1;
+        uint64_t m = static_cast<uint64_t>(n * 0.6180339887) | 1;
+        while (gcd(m, n) != 1) m += 2;
+        return m % n;
+    }
+    uint64_t scatter(uint64_t rank) const {
+        return static_cast<uint64_t>(
+            static_cast<unsigned __int128>(rank) * mult_ % n_);
+    }
+
+    /**
+     * @return a rank in [0, n), where 0 is the most frequent.
+     */
+    uint64_t getZipfRank() {
+        const double n = static_cast<double>(n_);
+        while (true) {
+            const double u = hIntegralN_ + getDouble() * (hIntegralX1_ - hIntegralN_);
+            const double x = hIntegralInverse(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1) {
+                k = 1;
+            } else if (k > n) {
+                k = n;
+            }
+            if (k - x <= s_ || u >= hIntegral(k + 0.5) - h(k)) {
+                return static_cast<uint64_t>(k) - 1;
+            }
+        }
+    }
+    double h(double x) const {
+        return std::exp(-cfg_.param1 * std::log(x));
+    }
+    double hIntegral(double x) const {
+        const double logX = std::log(x);
+        return helper2((1.0 - cfg_.param1) * logX) * logX;
+    }
+    double hIntegralInverse(double x) const {
+        double t = x * (1.0 - cfg_.param1);
+        if (t < -1.0) t = -1.0;
+        return std::exp(helper1(t) * x);
+    }
+    /**
+     * log1p(x) / x with care of x near 0.
+     */
+    static double helper1(double x) {
+        if (std::fabs(x) > 1e-8) return std::log1p(x) / x;
+        return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+    /**
+     * expm1(x) / x with care of x near 0.
+     */
+    static double helper2(double x) {
+        if (std::fabs(x) > 1e-8) return std::expm1(x) / x;
+        return 1.0 + x * 0.5 * (1.0 + x * 1.0 / 3.0 * (1.0 + 0.25 * x));
+    }
+
+    uint64_t getPermuted() {
+        if (permIdx_ == partEnd_) permIdx_ = partBgn_;
+        uint64_t x = permIdx_++;
+        do {
+            x = feistel(x);
+        } while (x >= n_);
+        return x;
+    }
+    uint64_t feistel(uint64_t x) const {
+        uint64_t l = x >> halfBits_;
+        uint64_t r = x & halfMask_;
+        for (uint64_t key : roundKeys_) {
+            const uint64_t t = l ^ (mix(r ^ key) & halfMask_);
+            l = r;
+            r = t;
+        }
+        return (l << halfBits_) | r;
+    }
+    void setRoundKeys() {
+        for (size_t i = 0; i < 4; i++) {
+            roundKeys_[i] = mix(permSeed_ ^ mix(i));
+        }
+    }
+    /**
+     * Finalizer of splitmix64.
+     */
+    static uint64_t mix(uint64_t z) {
+        z += 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t getNormal() {
+        const double n = static_cast<double>(n_);
+        const double center = n * cfg_.param2 / 100.0;
+        const double sigma = n * cfg_.param1 / 100.0;
+        while (true) {
+            const double x = center + sigma * getStdNormal();
+            if (0 <= x && x < n) return static_cast<uint64_t>(x);
+        }
+    }
+    /**
+     * Box-Muller transform. Each pair of uniform numbers gives two samples.
+     */
+    double getStdNormal() {
+        if (hasSpare_) {
+            hasSpare_ = false;
+            return spare_;
+        }
+        double u1;
+        do { u1 = getDouble(); } while (u1 == 0.0);
+        const double u2 = getDouble();
+        const double r = std::sqrt(-2.0 * std::log(u1));
+        spare_ = r * std::sin(2.0 * M_PI * u2);
+        hasSpare_ = true;
+        return r * std::cos(2.0 * M_PI * u2);
+    }
+};
+
+/**
+ * Blocks touched and access counts of blocks to know how skewed the accesses were.
+ * Each touched block is marked in a bitmap of its target, 1 bit per block.
+ * Counts are kept for every SAMPLE_INTERVAL-th IO only to keep the per-IO cost
+ * and the memory low. Without setRange(), only the IOs are counted.
+ */
+class AccessStatistics
+{
+private:
+    static const uint64_t SAMPLE_INTERVAL = 64;
+
+    std::vector<std::vector<uint64_t> > bitmaps_; /* index is target id. */
+    size_t targetId_;
+    std::unordered_map<uint64_t, uint64_t> counts_;
+    uint64_t total_; /* sampled IOs. */
+    uint64_t nrIos_;
+
+public:
+    AccessStatistics() : bitmaps_(), targetId_(0), counts_(), total_(0), nrIos_(0) {}
+
+    /**
+     * Record the blocks in add().
+     * @targetId index of the target when each thread has its own target, or 0.
+     * @nrBlocks number of blocks in the range.
+     */
+    void setRange(size_t targetId, uint64_t nrBlocks) {
+        if (bitmaps_.size() <= targetId) bitmaps_.resize(targetId + 1);
+        bitmaps_[targetId].resize((nrBlocks + 63) / 64, 0);
+        targetId_ = targetId;
+    }
+
+    void add(uint64_t blockId) {
+        if (bitmaps_.empty()) {
+            nrIos_++;
+            return;
+        }
+        std::vector<uint64_t>& bits = bitmaps_[targetId_];
+        assert(blockId / 64 < bits.size());
+        bits[blockId / 64] |= uint64_t(1) << (blockId % 64);
+        if (nrIos_++ % SAMPLE_INTERVAL != 0) return;
+        counts_[(static_cast<uint64_t>(targetId_) << 48) + blockId]++;
+        total_++;
+    }
+
+    void merge(const AccessStatistics& rhs) {
+        if (bitmaps_.size() < rhs.bitmaps_.size()) bitmaps_.resize(rhs.bitmaps_.size());
+        for (size_t i = 0; i < rhs.bitmaps_.size(); i++) {
+            std::vector<uint64_t>& bits = bitmaps_[i];
+            const std::vector<uint64_t>& rbits = rhs.bitmaps_[i];
+            if (bits.size() < rbits.size()) bits.resize(rbits.size(), 0);
+            for (size_t j = 0; j < rbits.size(); j++) bits[j] |= rbits[j];
+        }
+        if (counts_.empty()) {
+            counts_ = rhs.counts_;
+        } else {
+            for (const auto& p : rhs.counts_) {
+                counts_[p.first] += p.second;
+            }
+        }
+        total_ += rhs.total_;
+        nrIos_ += rhs.nrIos_;
+    }
+
+    uint64_t getNrIos() const { return nrIos_; }
+
+    uint64_t getNrUnique() const {
+        uint64_t n = 0;
+        for (const std::vector<uint64_t>& bits : bitmaps_) {
+            for (uint64_t w : bits) n += __builtin_popcountll(w);
+        }
+        return n;
+    }
+
+    /**
+     * Print unique blocks among all the IOs and the share of IOs
+     * to the top 1% blocks among the sampled IOs.
+     * @n number of blocks in the range.
+     */
+    void print(uint64_t n) const {
+        std::vector<uint64_t> v;
+        v.reserve(counts_.size());
+        for (const auto& p : counts_) v.push_back(p.second);
+        const size_t top = std::min<size_t>(v.size(), std::max<uint64_t>(1, n / 100));
+        std::nth_element(v.begin(), v.begin() + top, v.end(), std::greater<uint64_t>());
+        uint64_t topCount = 0;
+        for (size_t i = 0; i < top; i++) topCount += v[i];
+        const uint64_t unique = getNrUnique();
+        ::printf("Access: %" PRIu64 " IOs unique %" PRIu64 " / %" PRIu64
+                 " blocks (%.2f%%) top 1%% share %.2f%% of %" PRIu64 " sampled IOs.\n",
+                 nrIos_, unique, n, n == 0 ? 0.0 : 100.0 * unique / n,
+                 total_ == 0 ? 0.0 : 100.0 * topCount / total_, total_);
+    }
+};
@@ -9,6 +9,7 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <fstream>
 #include <queue>
 #include <utility>
 #include <tuple>
@@ -37,6 +38,8 @@
 #include "unit_int.hpp"
 #include "easy_signal.hpp"
 #include "histogram.hpp"
+#include "distribution.hpp"
+#include "trace.hpp"
 
 
 class Options
@@ -60,10 +63,34 @@ private:
     size_t flushInterval_;
     size_t ignorePeriod_;
     size_t readPct_;
-
+    std::string engineName_;
+    IoEngine engine_;
+    int rwFlags_;
+    bool isMmapCfgSet_;
+    size_t batchSize_;
+    bool isAioPerThread_;
+    bool isCacheCfgSet_;
+    bool isDistCfgSet_;
+    uint64_t seed_;
+    std::string replayPath_;
+    bool isReplayFast_;
+    std::string jobPath_;
+    std::string jobName_;
 
 public:
     HistogramConfig histogramCfg;
+    AsyncIoConfig asyncIoCfg;
+    MmapConfig mmapCfg;
+    CacheConfig cacheCfg;
+    TrimConfig trimCfg;
+    VectorConfig vectorCfg;
+    DistConfig distCfg;
+    BsSplitConfig bsSplit;
+    ArrivalConfig arrivalCfg;
+    RateConfig iopsCfg;
+    RateConfig bpsCfg;
+    PlacementConfig placementCfg;
+    AffinityConfig affinityCfg;
 
     Options(int argc, char* argv[])
         : accessRange_(0)
@@ -82,11 +109,38 @@ public:
         , flushInterval_(0)
         , ignorePeriod_(0)
         , readPct_(0)
-        , histogramCfg() {
-
+        , engineName_()
+        , engine_(ENGINE_SYNC)
+        , rwFlags_(0)
+        , isMmapCfgSet_(false)
+        , batchSize_(1)
+        , isAioPerThread_(false)
+        , isCacheCfgSet_(false)
+        , isDistCfgSet_(false)
+        , seed_(0)
+        , replayPath_()
+        , isReplayFast_(false)
+        , jobPath_()
+        , jobName_()
+        , histogramCfg()
+        , asyncIoCfg()
+        , mmapCfg()
+        , cacheCfg()
+        , trimCfg()
+        , vectorCfg()
+        , distCfg()
+        , bsSplit()
+        , arrivalCfg()
+        , iopsCfg()
+        , bpsCfg()
+        , placementCfg()
+        , affinityCfg() {
+
+        std::random_device rd;
+        seed_ = (static_cast<uint64_t>(rd()) << 32) | rd();
         parse(argc, argv);
 
-        if (isShowVersion_ || isShowHelp_) {
+        if (isShowVersion_ || isShowHelp_ || isJobFile()) {
             return;
         }
         checkAndThrow();
@@ -97,10 +151,27 @@ public:
     }
 
     void showHelp() {
-        ::printf("usage: %s [option(s)] [file or device]\n"
+        ::printf("usage: %s [option(s)] [file or device]...\n"
                  "options: \n"
                  "    -s size: access range in blocks.\n"
-                 "    -b size: blocksize in bytes.\n"
+                 "    -b size: blocksize in bytes, or a mix of sizes as\n"
+                 "             size:weight,size:weight,... (e.g. 4k:60,16k:30,128k:10).\n"
+                 "             each IO chooses a size by the weights and is aligned to it.\n"
+                 "             the sizes must be multiples of the smallest one, which is\n"
+                 "             the unit of -s and -z. stats are reported for each size.\n"
+                 "    -z dist: access distribution of blocks. default: uniform.\n"
+                 "             perm visits each block once per pass in random order,\n"
+                 "             where the threads share each pass without overlap.\n"
+                 "             seq visits blocks in order, where each thread walks\n"
+                 "             its own part of the range.\n"
+                 "             zipf:theta, pareto:h (1-h of IOs go to h of blocks),\n"
+                 "             normal:sigma[:center] (percentages of the range),\n"
+                 "             or hotcold:ios:blocks (ios%% of IOs go to blocks%% of blocks).\n"
+                 "             unique blocks of all IOs and the top 1%% share\n"
+                 "             of every 64th IO are reported.\n"
+                 "             perm and seq report the passes made instead.\n"
+                 "    -S seed: seed of random numbers. each thread uses its own streams.\n"
+                 "             default: random.\n"
                  "    -p secs: execute period in seconds.\n"
                  "    -c num:  number of IOs to execute.\n"
                  "             -p and -c is exclusive.\n"
@@ -108,14 +179,76 @@ public:
                  "    -m pct:  read/write mix instead read. pct means read percentage from 1 to 99.\n"
                  "    -d:      discard instead read.\n"
                  "             -w, -m, and -d is exclusive.\n"
+                 "    -T kind[,pct]: mix trim IOs of kind at pct%% (default: 100) into the IOs.\n"
+                 "             kind is discard, zeroout, or punch.\n"
+                 "             -d with -t 0 or -a is the same as -T discard.\n"
+                 "             this is meaningfull with -e uring.\n"
+                 "    -V split: issue each IO as iovecs on separately allocated buffers.\n"
+                 "             split is num for num equal iovecs, rand,num for num iovecs\n"
+                 "             of random sizes for each IO, or size,size,... for the sizes.\n"
                  "    -t num:  number of threads in parallel.\n"
                  "             if 0, use aio instead thread.\n"
                  "    -q size: queue size per thread.\n"
-                 "             this is meaningfull with -t 0.\n"
+                 "             this is meaningfull with -t 0 or -a.\n"
+                 "    -a:      each of the threads uses aio with queue size -q.\n"
+                 "    -O rate[,fixed|poisson]: issue IOs at rate [IO/s] in total (open loop)\n"
+                 "             with fixed (default) or poisson intervals, instead of\n"
+                 "             after completions of others. responses are measured from\n"
+                 "             the scheduled issue times. this requires -t 0 or -a.\n"
+                 "    -P file[,fast]: replay a trace with a worker using aio per thread\n"
+                 "             of the trace, keeping the start times of the IOs, or\n"
+                 "             as fast as possible with queue size -q per worker with fast.\n"
+                 "             file is output of -r (blocks of -b), blkparse, or blktrace.\n"
+                 "             IOs beyond the target wrap around. writes are replayed\n"
+                 "             as reads unless -w, and discards need -w and -e uring.\n"
+                 "             -c and -p limit the IOs. recorded and replayed responses\n"
+                 "             are compared.\n"
+                 "    -J file: run the jobs in file at the same time. each line is\n"
+                 "             'name: options target' with the options above except\n"
+                 "             -t 0, -P, and -J, and '#' starts a comment.\n"
+                 "             each job is reported followed by all the jobs combined.\n"
+                 "    -L place: placement of IOs on multiple targets.\n"
+                 "             stripe[,chunk] (default) places chunks on the targets in turn,\n"
+                 "             hash[,chunk] places them by a hash of the offset,\n"
+                 "             and thread makes thread i use target i %% the targets.\n"
+                 "             -s and -z cover all the targets as one range. the chunk\n"
+                 "             size must be a multiple of -b. default: 64KiB or more.\n"
+                 "             stats are reported for each target.\n"
+                 "    -R iops[,thread]: cap IOs per second shared by the threads,\n"
+                 "             or of each thread with ',thread'.\n"
+                 "    -B bytes[,thread]: cap bytes per second in the same way.\n"
+                 "             each IO waits for a token bucket, which saves up to\n"
+                 "             1ms of tokens while idle.\n"
+                 "    -e name: IO engine, 'sync', 'pvsync2', 'mmap', 'aio', or 'uring'.\n"
+                 "             sync, pvsync2, and mmap are for threads, and the default is sync.\n"
+                 "             aio and uring are for -t 0 or -a, and the default is aio.\n"
+                 "    -F flags: RWF flags for -e pvsync2 as a comma-separated list of\n"
+                 "             hipri, nowait, dsync, and append.\n"
+                 "    -M opts: options for -e mmap as a comma-separated list of\n"
+                 "             populate, and one of random, sequential, or willneed.\n"
+                 "             -f calls msync() with -e mmap.\n"
+                 "    -Q idle[,cpu]: submit IOs by a kernel polling thread (SQPOLL)\n"
+                 "             which sleeps after idle [ms] and runs on cpu.\n"
+                 "             this is meaningfull with -e uring.\n"
+                 "    -u:      reap aio completions in user space when available.\n"
+                 "             this is meaningfull with -e aio.\n"
+                 "    -k num:  reap up to num IOs at once and resubmit them together.\n"
+                 "             default: 1. this is meaningfull with -t 0 or -a.\n"
+                 "    -A cpus: pin thread i to cpu i %% the cpus, where cpus is a list\n"
+                 "             like 0-3,8, compact to fill a NUMA node before the next,\n"
+                 "             or scatter to take the nodes in turn. the worker of -t 0\n"
+                 "             is thread 0. the placement is reported before the run.\n"
+                 "    -N:      bind buffers and aio structures of each thread\n"
+                 "             to the NUMA node of its cpu. this requires -A.\n"
                  "    -f nIO:  flush interval [IO]. default: 0.\n"
                  "             0 means flush request will never occur.\n"
                  "    -i secs: start to measure performance after several seconds.\n"
                  "    -n:      do not use O_DIRECT.\n"
+                 "    -C opts: page cache control for -n or -e mmap as a comma-separated list of\n"
+                 "             drop: evict pages of the target before the run,\n"
+                 "             warm=pct: load the first pct%% of the access range before the run,\n"
+                 "             hit=usec: regard reads faster than usec as cache hits. default: 20.\n"
+                 "             page cache residency is reported after the run.\n"
                  "    -r:      show response of each IO.\n"
                  "    -H min,max,interval: show histogram with parameters [ms]\n"
                  "    -v:      show version.\n"
@@ -140,14 +273,42 @@ public:
     size_t getFlushInterval() const { return flushInterval_; }
     size_t getIgnorePeriod() const { return ignorePeriod_; }
     size_t getReadPct() const { return readPct_; }
+    IoEngine getEngine() const { return engine_; }
+    int getRwFlags() const { return rwFlags_; }
+    size_t getBatchSize() const { return batchSize_; }
+    bool isAioPerThread() const { return isAioPerThread_; }
+    bool isCacheCfgSet() const { return isCacheCfgSet_; }
+    bool isDistCfgSet() const { return isDistCfgSet_; }
+    uint64_t getSeed() const { return seed_; }
+    bool isReplay() const { return !replayPath_.empty(); }
+    const std::string& getReplayPath() const { return replayPath_; }
+    bool isReplayFast() const { return isReplayFast_; }
+    bool isJobFile() const { return !jobPath_.empty(); }
+    const std::string& getJobPath() const { return jobPath_; }
+    const std::string& getJobName() const { return jobName_; }
+    void setJobName(const std::string& name) { jobName_ = name; }
+    /**
+     * Prefix of lines for each thread, which tells the job.
+     */
+    std::string getIdPrefix() const { return jobName_.empty() ? "" : jobName_ + " "; }
+    Throttle getThrottle() const {
+        return Throttle(iopsCfg, bpsCfg, nthreads_, bsSplit.getMax());
+    }
+    /**
+     * Mode to open the device. Trim IOs require it writable.
+     */
+    Mode getOpenMode() const {
+        return (trimCfg.isEnabled() && mode_ == READ_MODE) ? MIX_MODE : mode_;
+    }
 
 private:
     void parse(int argc, char* argv[]) {
 
         programName_ = argv[0];
+        optind = 0; /* reinitialize getopt() for each job. */
 
         while (1) {
-            int c = ::getopt(argc, argv, "s:b:p:c:t:q:f:i:wm:H:drnvh");
+            int c = ::getopt(argc, argv, "s:b:z:S:p:c:t:q:aO:P:J:L:R:B:e:F:M:Q:uk:A:Nf:i:wm:H:C:T:V:drnvh");
 
             if (c < 0) { break; }
 
@@ -155,8 +316,16 @@ private:
             case 's': /* disk access range in blocks */
                 accessRange_ = fromUnitIntString(optarg);
                 break;
-            case 'b': /* blocksize */
-                blockSize_ = fromUnitIntString(optarg);
+            case 'b': /* blocksize or bssplit */
+                bsSplit.set(optarg);
+                blockSize_ = bsSplit.getMin();
+                break;
+            case 'z': /* access distribution */
+                isDistCfgSet_ = true;
+                distCfg.set(optarg);
+                break;
+            case 'S': /* seed */
+                seed_ = ::strtoull(optarg, nullptr, 0);
                 break;
             case 'p': /* period */
                 period_ = ::atol(optarg);
@@ -174,12 +343,64 @@ private:
             case 'd': /* discard */
                 mode_ = DISCARD_MODE;
                 break;
+            case 'T': /* trim mix */
+                trimCfg.set(optarg);
+                break;
+            case 'V': /* vectored IO */
+                vectorCfg.set(optarg);
+                break;
             case 't': /* nthreads */
                 nthreads_ = ::atol(optarg);
                 break;
             case 'q': /* queue size */
                 queueSize_ = ::atol(optarg);
                 break;
+            case 'a': /* aio per thread */
+                isAioPerThread_ = true;
+                break;
+            case 'O': /* open-loop arrivals */
+                arrivalCfg.set(optarg);
+                break;
+            case 'P': /* trace replay */
+                parseReplay(optarg);
+                break;
+            case 'J': /* job file */
+                jobPath_ = optarg;
+                break;
+            case 'L': /* placement on targets */
+                placementCfg.set(optarg);
+                break;
+            case 'R': /* IOPS cap */
+                iopsCfg.set(optarg);
+                break;
+            case 'B': /* bandwidth cap */
+                bpsCfg.set(optarg);
+                break;
+            case 'e': /* IO engine */
+                engineName_ = optarg;
+                break;
+            case 'F': /* RWF flags */
+                rwFlags_ = parseRwFlags(optarg);
+                break;
+            case 'M': /* mmap options */
+                isMmapCfgSet_ = true;
+                mmapCfg.set(optarg);
+                break;
+            case 'Q': /* SQPOLL */
+                asyncIoCfg.setSqpoll(optarg);
+                break;
+            case 'u': /* user space reaping */
+                asyncIoCfg.isUserReap = true;
+                break;
+            case 'k': /* batch size */
+                batchSize_ = ::atol(optarg);
+                break;
+            case 'A': /* cpu affinity */
+                affinityCfg.set(optarg);
+                break;
+            case 'N': /* NUMA memory binding */
+                affinityCfg.isNumaBind = true;
+                break;
             case 'f': /* flush interval */
                 flushInterval_ = ::atol(optarg);
                 break;
@@ -192,6 +413,10 @@ private:
             case 'n': /* do not use O_DIRECT */
                 dontUseOdirect_ = true;
                 break;
+            case 'C': /* page cache control */
+                isCacheCfgSet_ = true;
+                cacheCfg.set(optarg);
+                break;
             case 'v': /* show version */
                 isShowVersion_ = true;
                 break;
@@ -219,19 +444,91 @@ private:
         uint64_t interval = ::strtoull(v[2].c_str(), nullptr, 10);
         histogramCfg.set(min, max, interval);
     }
+    void parseReplay(const char *optarg) {
+        std::vector<std::string> v = splitString(optarg, ',');
+        if (v.empty() || v.size() > 2 || (v.size() == 2 && v[1] != "fast")) {
+            throw std::runtime_error("specify replay as file[,fast].");
+        }
+        replayPath_ = v[0];
+        isReplayFast_ = v.size() == 2;
+    }
     void checkAndThrow() {
-        if (args_.size() != 1 || blockSize_ == 0) {
+        if (args_.empty() || blockSize_ == 0) {
             throw std::runtime_error("specify blocksize (-b), and device.");
         }
-        if (period_ == 0 && count_ == 0) {
+        if (period_ == 0 && count_ == 0 && !isReplay()) {
             throw std::runtime_error("specify period (-p) or count (-c).");
         }
-        if (nthreads_ == 0 && queueSize_ == 0) {
-            throw std::runtime_error("queue size (-q) must be 1 or more when -t 0.");
+        if (isReplay() && (arrivalCfg.isEnabled() || vectorCfg.isEnabled() ||
+                           bsSplit.isSplit() || isCacheCfgSet_ || isDistCfgSet_ ||
+                           mode_ == MIX_MODE || mode_ == DISCARD_MODE)) {
+            throw std::runtime_error("replay (-P) does not work with -O, -V, -C, -z, -m, -d,"
+                                     " and a mix of block sizes.");
+        }
+        const bool isAio = nthreads_ == 0 || isAioPerThread_ || isReplay();
+        if (isAio && dontUseOdirect_) {
+            throw std::runtime_error("-n does not work with -t 0, -a, and -P, which always use O_DIRECT.");
+        }
+        if (isAio && queueSize_ == 0) {
+            throw std::runtime_error("queue size (-q) must be 1 or more when -t 0 or -a.");
+        }
+        if (batchSize_ == 0 || (isAio && batchSize_ > queueSize_)) {
+            throw std::runtime_error("batch size (-k) must be between 1 and queue size.");
         }
         if (readPct_ > 100) {
             throw std::runtime_error("read percentage must be between 0 and 100.");
         }
+        if (affinityCfg.isNumaBind && !affinityCfg.isEnabled()) {
+            throw std::runtime_error("NUMA binding (-N) requires cpu affinity (-A).");
+        }
+        if (engineName_.empty()) {
+            engine_ = isAio ? ENGINE_LIBAIO : ENGINE_SYNC;
+        } else {
+            engine_ = parseIoEngine(engineName_);
+        }
+        if (isAsyncEngine(engine_) != isAio) {
+            throw std::runtime_error("engine (-e) does not match -t and -a.");
+        }
+        if (rwFlags_ != 0 && engine_ != ENGINE_PVSYNC2) {
+            throw std::runtime_error("RWF flags (-F) require -e pvsync2.");
+        }
+        if (isMmapCfgSet_ && engine_ != ENGINE_MMAP) {
+            throw std::runtime_error("mmap options (-M) require -e mmap.");
+        }
+        if (asyncIoCfg.isSqpoll() && engine_ != ENGINE_URING) {
+            throw std::runtime_error("SQPOLL (-Q) requires -e uring.");
+        }
+        if (asyncIoCfg.isUserReap && engine_ != ENGINE_LIBAIO) {
+            throw std::runtime_error("user space reaping (-u) requires -e aio.");
+        }
+        vectorCfg.setBlockSize(blockSize_);
+        if (vectorCfg.isEnabled() && bsSplit.isSplit()) {
+            throw std::runtime_error("vectored IO (-V) does not work with a mix of block sizes.");
+        }
+        if (vectorCfg.isEnabled() && engine_ == ENGINE_MMAP) {
+            throw std::runtime_error("vectored IO (-V) does not work with -e mmap.");
+        }
+        if (mode_ == DISCARD_MODE && isAio) {
+            trimCfg.pct = 100;
+        }
+        if (trimCfg.isEnabled() && (!isAio || engine_ != ENGINE_URING)) {
+            throw std::runtime_error("trim IOs (-T, or -d with -t 0 or -a) require -e uring.");
+        }
+        if (arrivalCfg.isEnabled() && !isAio) {
+            throw std::runtime_error("open-loop arrivals (-O) require -t 0 or -a.");
+        }
+        if (isCacheCfgSet_ && (isAio || (!dontUseOdirect_ && engine_ != ENGINE_MMAP))) {
+            throw std::runtime_error("page cache control (-C) requires -n or -e mmap with threads.");
+        }
+        if (args_.size() > 1) {
+            if (isReplay() || isCacheCfgSet_) {
+                throw std::runtime_error("replay (-P) and -C work with only one target.");
+            }
+            if (placementCfg.type == PLACE_THREAD && nthreads_ == 0) {
+                throw std::runtime_error("thread placement (-L thread) requires threads (-t).");
+            }
+            placementCfg.setChunkSize(bsSplit);
+        }
     }
 };
 
@@ -244,18 +541,24 @@ void quitHandler(int)
 }
 
 
-std::vector<Histogram> generateHistogram(const HistogramConfig& cfg)
+/**
+ * @nrSizes number of IO sizes. Each size has its own 3 histograms.
+ */
+std::vector<Histogram> generateHistogram(const HistogramConfig& cfg, size_t nrSizes)
 {
-    std::vector<Histogram> hs(3);
+    std::vector<Histogram> hs(3 * nrSizes);
     for (auto& h : hs) h.reset(cfg);
     return hs;
 }
 
 
-void addToHistogram(std::vector<Histogram>& hs, const IoLog& log)
+/**
+ * @sizeIdx index of the IO size.
+ */
+void addToHistogram(std::vector<Histogram>& hs, const IoLog& log, size_t sizeIdx)
 {
-    assert(hs.size() == 3);
-    // 0: read, 1: write, 2: flush/discard
+    assert(hs.size() % 3 == 0 && sizeIdx < hs.size() / 3);
+    // 0: read, 1: write, 2: flush/discard for each size
     size_t idx;
     switch(log.type) {
     case IOTYPE_READ:
@@ -268,7 +571,37 @@ void addToHistogram(std::vector<Histogram>& hs, const IoLog& log)
         idx = 2;
     }
     uint64_t response_ms = uint64_t(log.response * 1000);
-    hs[idx].add(response_ms);
+    hs[sizeIdx * 3 + idx].add(response_ms);
+}
+
+
+/**
+ * Print histograms of each IO size.
+ */
+void printHistograms(const std::vector<Histogram>& hs, const BsSplitConfig& bsSplit)
+{
+    ::printf("HISTOGRAM BEGIN\n");
+    Histogram::joinAndPrint(hs);
+    if (bsSplit.isSplit()) {
+        for (size_t i = 0; i < bsSplit.getNr(); i++) {
+            ::printf("# size %zu: read %zu write %zu flush/discard %zu\n",
+                     bsSplit.sizes[i], i * 3, i * 3 + 1, i * 3 + 2);
+        }
+    }
+    ::printf("HISTOGRAM END\n");
+}
+
+
+/**
+ * Verify the access range contains the largest IO.
+ * @return accessRange.
+ */
+size_t checkAccessRange(size_t accessRange, const BsSplitConfig& bsSplit)
+{
+    if (accessRange * bsSplit.getMin() < bsSplit.getMax()) {
+        throw std::runtime_error("access range is smaller than the largest block size.");
+    }
+    return accessRange;
 }
 
 
@@ -279,69 +612,106 @@ class IoResponseBench
 {
 private:
     const int threadId_;
-    BlockDevice& dev_;
-    const size_t blockSize_;
+    TargetSet& targets_;
+    const BsSplitConfig bsSplit_;
+    const size_t blockSize_; /* the smallest IO size. */
     const size_t accessRange_;
     void* bufV_;
     char* buf_;
     std::queue<IoLog>& rtQ_;
     std::vector<Histogram>& histograms_;
     PerformanceStatistics& stat_;
+    PerformanceStatistics& hitStat_;
+    PerformanceStatistics& missStat_;
+    std::vector<PerformanceStatistics>& sizeStats_; /* indexed as bsSplit_.sizes. */
+    TargetStatistics& targetStats_;
     const bool isShowEachResponse_;
     const bool isShowHistogram_;
-    XorShift128 rand_;
+    const double hitThreshold_; /* [sec]. negative means not to classify reads. */
+    Xoshiro256 rand_;
+    BlockDistribution dist_;
+    AccessStatistics* accessStat_; /* null means not to record. */
     const size_t flushInterval_;
     const size_t ignorePeriod_;
     const size_t readPct_;
-
-    std::mutex& mutex_; //shared among threads.
+    IovecBuffer iovBuf_;
+    size_t sizeIdx_; /* index of the size of the last IO. */
+    Throttle throttle_;
 
 public:
     /**
-     * @param dev block device.
-     * @param bs block size.
-     * @param accessRange in blocks.
+     * @param targets block devices.
+     * @param bsSplit IO sizes.
+     * @param accessRange in blocks of the smallest IO size.
+     * @param seed seed of random numbers shared by threads.
+     * @param hitThreshold reads faster than this [sec] go to hitStat and
+     *   the others go to missStat. negative means not to classify.
+     * @param sizeStats statistics of each IO size.
+     * @param targetStats statistics of each target. empty means not to record.
+     * @param throttle caps of IOPS and bandwidth of this thread.
      */
-    IoResponseBench(int threadId, BlockDevice& dev, size_t blockSize,
+    IoResponseBench(int threadId, TargetSet& targets, const BsSplitConfig& bsSplit,
                     size_t accessRange, std::queue<IoLog>& rtQ,
                     std::vector<Histogram>& histograms,
                     PerformanceStatistics& stat,
+                    PerformanceStatistics& hitStat,
+                    PerformanceStatistics& missStat,
+                    std::vector<PerformanceStatistics>& sizeStats,
+                    TargetStatistics& targetStats,
                     bool isShowEachResponse,
                     bool isShowHistogram,
+                    double hitThreshold,
                     size_t flushInterval, size_t ignorePeriod, size_t readPct,
-                    std::mutex& mutex)
+                    const VectorConfig& vectorCfg, const DistConfig& distCfg,
+                    AccessStatistics* accessStat, const Throttle& throttle,
+                    uint64_t seed)
         : threadId_(threadId)
-        , dev_(dev)
-        , blockSize_(blockSize)
-        , accessRange_(calcAccessRange(accessRange, blockSize, dev))
+        , targets_(targets)
+        , bsSplit_(bsSplit)
+        , blockSize_(bsSplit.getMin())
+        , accessRange_(checkAccessRange(calcAccessRange(accessRange, blockSize_, targets), bsSplit))
         , bufV_(nullptr)
         , buf_(nullptr)
         , rtQ_(rtQ)
         , histograms_(histograms)
         , stat_(stat)
+        , hitStat_(hitStat)
+        , missStat_(missStat)
+        , sizeStats_(sizeStats)
+        , targetStats_(targetStats)
         , isShowEachResponse_(isShowEachResponse)
         , isShowHistogram_(isShowHistogram)
-        , rand_(getSeed())
+        , hitThreshold_(hitThreshold)
+        , rand_(Xoshiro256::stream(seed, threadId * 3))
+        , dist_(distCfg, accessRange_, Xoshiro256::stream(seed, threadId * 3 + 1))
+        , accessStat_(accessStat)
         , flushInterval_(flushInterval)
         , ignorePeriod_(ignorePeriod)
         , readPct_(readPct)
-        , mutex_(mutex) {
+        , iovBuf_(1, blockSize_, vectorCfg, Xoshiro256::stream(seed, threadId * 3 + 2))
+        , sizeIdx_(0)
+        , throttle_(throttle) {
 #if 0
         ::printf("blockSize %zu accessRange %zu isShowEachResponse %d\n",
                  blockSize_, accessRange_, isShowEachResponse_);
 #endif
+        const size_t bufSize = bsSplit_.getMax();
         size_t alignSize = 512;
-        while (alignSize < blockSize_) {
+        while (alignSize < bufSize) {
             alignSize *= 2;
         }
-        if(::posix_memalign(&bufV_, alignSize, blockSize_) != 0) {
+        if(::posix_memalign(&bufV_, alignSize, bufSize) != 0) {
             throw std::runtime_error("posix_memalign failed");
         }
         buf_ = static_cast<char*>(bufV_);
 
-        for (size_t i = 0; i < blockSize_; i++) {
+        for (size_t i = 0; i < bufSize; i++) {
             buf_[i] = static_cast<char>(rand_.get(256));
         }
+        /* blocks of -z perm and seq are known, so only the IOs are counted. */
+        if (accessStat_ && !distCfg.isCoverageKnown()) {
+            accessStat_->setRange(targets_.getNr() == 1 ? targets_.getId(0) : 0, accessRange_);
+        }
     }
     ~IoResponseBench() {
         ::free(bufV_);
@@ -360,9 +730,11 @@ public:
                 if (isShowEachResponse_) { rtQ_.push(log); }
                 addToHistogram(log);
                 stat_.updateRt(log.response);
+                addToSizeStat(log);
+                addToTargetStat(log);
+                addToCacheStat(log);
             }
         }
-        putStat();
     }
     void execNsecs(size_t n) {
         const double bgn = getTime();
@@ -379,15 +751,38 @@ public:
                 if (isShowEachResponse_) rtQ_.push(log);
                 addToHistogram(log);
                 stat_.updateRt(log.response);
+                addToSizeStat(log);
+                addToTargetStat(log);
+                addToCacheStat(log);
             }
             i++;
         }
-        putStat();
     }
 
     void addToHistogram(const IoLog& log) {
         if (!isShowHistogram_) return;
-        ::addToHistogram(histograms_, log);
+        ::addToHistogram(histograms_, log, sizeIdx_);
+    }
+
+    void addToTargetStat(const IoLog& log) {
+        if (!targetStats_.isEnabled() || log.type == IOTYPE_FLUSH) return;
+        targetStats_.add(targets_.getLastId(), bsSplit_.sizes[sizeIdx_], log.response);
+    }
+
+    void addToSizeStat(const IoLog& log) {
+        if (!bsSplit_.isSplit() || log.type == IOTYPE_FLUSH) return;
+        sizeStats_[sizeIdx_].updateRt(log.response);
+    }
+
+    BlockDistribution& getDistribution() { return dist_; }
+
+    void addToCacheStat(const IoLog& log) {
+        if (hitThreshold_ < 0 || log.type != IOTYPE_READ) return;
+        if (log.response < hitThreshold_) {
+            hitStat_.updateRt(log.response);
+        } else {
+            missStat_.updateRt(log.response);
+        }
     }
 
 private:
@@ -395,13 +790,16 @@ private:
      * @return response time.
      */
     IoLog execBlockIO() {
-        size_t blockId = rand_.get(accessRange_);
-        size_t oft = blockId * blockSize_;
+        size_t blockId = dist_.get();
+        if (accessStat_) accessStat_->add(blockId);
+        const size_t size = bsSplit_.pick(rand_);
+        const size_t oft = bsSplit_.getOffset(blockId, size, accessRange_);
+        sizeIdx_ = bsSplit_.isSplit() ? bsSplit_.getIndex(size) : 0;
 
         bool isWrite = false;
         bool isDiscard = false;
         IoType type;
-        switch(dev_.getMode()) {
+        switch(targets_.getMode()) {
         case READ_MODE:
             isWrite = false;
             type = IOTYPE_READ;
@@ -422,194 +820,158 @@ private:
             assert(false);
         }
 
+        const int nrSegs = iovBuf_.getNrSegs();
+        struct iovec *iov = nrSegs > 0 ? iovBuf_.next() : nullptr;
+        throttle_.acquire(size);
         double bgn = getTime();
         if (isDiscard) {
-            dev_.discard(oft, blockSize_);
+            targets_.discard(oft, size);
+        } else if (iov) {
+            if (isWrite) {
+                targets_.writev(oft, iov, nrSegs);
+            } else {
+                targets_.readv(oft, iov, nrSegs);
+            }
         } else if (isWrite) {
-            dev_.write(oft, blockSize_, buf_);
+            targets_.write(oft, size, buf_);
         } else {
-            dev_.read(oft, blockSize_, buf_);
+            targets_.read(oft, size, buf_);
         }
         double end = getTime();
 
-        return IoLog(threadId_, type, blockId, bgn, end - bgn);
+        return IoLog(threadId_, type, oft / blockSize_, bgn, end - bgn);
     }
 
     /**
      * @return response time.
      */
     IoLog execFlushIO() {
+        sizeIdx_ = 0;
+        throttle_.acquire(0);
         double bgn = getTime();
-        dev_.flush();
+        targets_.flush();
         double end = getTime();
         return IoLog(threadId_, IOTYPE_FLUSH, 0, bgn, end - bgn);
     }
-
-    void putStat() const {
-        std::lock_guard<std::mutex> lk(mutex_);
-
-        ::printf("id %d ", threadId_);
-        stat_.print();
-    }
-
-    uint32_t getSeed() const {
-        Rand<uint32_t, std::uniform_int_distribution<uint32_t> >
-            rand(0, std::numeric_limits<uint32_t>::max());
-        return rand.get();
-    }
 };
 
-void do_work(int threadId, const Options& opt,
-             std::queue<IoLog>& rtQ, std::vector<Histogram>& histograms, PerformanceStatistics& stat,
-             std::mutex& mutex)
-{
-    const bool isDirect = !opt.dontUseOdirect();;
-
-    BlockDevice bd(opt.getArgs()[0], opt.getMode(), isDirect);
-
-    IoResponseBench bench(threadId, bd, opt.getBlockSize(), opt.getAccessRange(),
-                          rtQ, histograms, stat, opt.isShowEachResponse(),
-                          opt.isShowHistogram(), opt.getFlushInterval(),
-                          opt.getIgnorePeriod(), opt.getReadPct(), mutex);
-    if (opt.getPeriod() > 0) {
-        bench.execNsecs(opt.getPeriod());
-    } else {
-        bench.execNtimes(opt.getCount());
-    }
-}
-
-
-void worker_start(std::vector<std::future<void> >& workers, size_t nr, const Options& opt,
-                  std::vector<std::queue<IoLog> >& rtQs,
-                  std::vector<std::vector<Histogram> >& histogramss,
-                  std::vector<PerformanceStatistics>& stats,
-                  std::mutex& mutex)
-{
-    rtQs.resize(nr);
-    if (opt.isShowHistogram()) {
-        histogramss.reserve(nr);
-        for (size_t i = 0; i < nr; i++) {
-            histogramss.push_back(generateHistogram(opt.histogramCfg));
-        }
-    } else {
-        histogramss.resize(nr);
-    }
-    stats.resize(nr);
-    for (size_t i = 0; i < nr; i++) {
-        std::future<void> f = std::async(
-            std::launch::async, do_work, i, std::ref(opt), std::ref(rtQs[i]),
-            std::ref(histogramss[i]), std::ref(stats[i]), std::ref(mutex));
-        workers.push_back(std::move(f));
-    }
-}
-
-void worker_join(std::vector<std::future<void> >& workers)
-{
-    std::for_each(workers.begin(), workers.end(),
-                  [](std::future<void>& f) { f.get(); });
-}
-
-void pop_and_show_logQ(std::queue<IoLog>& logQ)
-{
-    while (! logQ.empty()) {
-        IoLog& log = logQ.front();
-        log.print();
-        logQ.pop();
-    }
-}
-
-void execThreadExperiment(const Options& opt)
-{
-    const size_t nthreads = opt.getNthreads();
-    assert(nthreads > 0);
-
-    std::vector<std::queue<IoLog> > logQs;
-    std::vector<std::vector<Histogram> > hss;
-    std::vector<PerformanceStatistics> stats;
-
-    std::vector<std::future<void> > workers;
-    std::mutex mutex;
-
-    const double bgn = getTime();
-    worker_start(workers, nthreads, opt, logQs, hss, stats, mutex);
-    worker_join(workers);
-    const double end = getTime();
-
-    assert(logQs.size() == nthreads);
-    std::for_each(logQs.begin(), logQs.end(), pop_and_show_logQ);
-
-    if (opt.isShowHistogram()) {
-        std::vector<Histogram> hsTotal = generateHistogram(opt.histogramCfg);
-        for (const auto& hs : hss) {
-            for (size_t i = 0; i < 3; i++) {
-                hsTotal[i].merge(hs[i]);
-            }
-        }
-        ::printf("HISTOGRAM BEGIN\n");
-        Histogram::joinAndPrint(hsTotal);
-        ::printf("HISTOGRAM END\n");
-    }
-
-    PerformanceStatistics stat = mergeStats(stats.begin(), stats.end());
-    ::printf("---------------\n"
-             "all ");
-    stat.print();
-    const double period =
-        end - bgn - static_cast<double>(opt.getIgnorePeriod());
-    if (period > 0) {
-        printThroughput(opt.getBlockSize(), stat.getCount(), period);
-    } else {
-        printZeroThroughput();
-    }
-}
-
 /**
  * Io response bench with aio.
+ * AsyncIo is Aio or IoUring.
  */
+template <typename AsyncIo>
 class AioResponseBench
 {
 private:
-    const size_t blockSize_;
+    const int threadId_;
+    const BsSplitConfig bsSplit_;
+    const size_t blockSize_; /* the smallest IO size. */
     const size_t queueSize_;
     const size_t accessRange_;
     const bool isShowEachResponse_;
     const bool isShowHistogram_;
     const size_t flushInterval_;
     const size_t ignorePeriod_;
+    const size_t readPct_; /* for MIX_MODE. */
     const Mode mode_;
+    const size_t batchSize_;
+    const TrimConfig trimCfg_;
+    const TargetSet& targets_;
 
     BlockBuffer bb_;
-    Rand<size_t, std::uniform_int_distribution<size_t> > rand_;
+    IovecBuffer iovBuf_;
+    Xoshiro256 rand_;
     std::queue<IoLog> logQ_;
     std::vector<Histogram> histograms_;
     PerformanceStatistics stat_;
-    Aio aio_;
+    std::vector<PerformanceStatistics> typeStats_; /* indexed by IoType. */
+    std::vector<PerformanceStatistics> sizeStats_; /* indexed as bsSplit_.sizes. */
+    TargetStatistics targetStats_;
+    size_t nrFlushes_;
+    PerformanceStatistics serviceStat_; /* from submission to completion in open loop. */
+    PerformanceStatistics lagStat_; /* from the scheduled time to submission in open loop. */
+    size_t nrLate_;
+    double lateThreshold_; /* [sec] */
+    BlockDistribution dist_;
+    AccessStatistics accessStat_;
+    const bool isRecordAccess_;
+    Throttle throttle_;
+    AsyncIo aio_;
     double bgnTime_;
+    std::vector<AioData *> doneV_; /* temporal use for waitIos(). */
+    BatchStatistics reapStat_;
+    BatchStatistics submitStat_;
 
 public:
+    /**
+     * @mode IO mode, which may differ from the mode of targets.
+     * @nrTargets number of all the targets to record statistics of each.
+     *   1 means not to record.
+     * @bsSplit IO sizes. accessRange is in blocks of the smallest one.
+     * @readPct read percentage of MIX_MODE.
+     * @trimCfg trim IOs mixed into the IOs.
+     * @vectorCfg split of each IO into iovecs.
+     * @distCfg access distribution of blocks.
+     * @isRecordAccess record accesses of each block to get access statistics.
+     * @throttle caps of IOPS and bandwidth of this worker.
+     * @seed seed of random numbers shared by threads.
+     */
     AioResponseBench(
-        const BlockDevice& dev, size_t blockSize, size_t queueSize,
+        int threadId, const TargetSet& targets, size_t nrTargets, Mode mode,
+        const BsSplitConfig& bsSplit, size_t queueSize,
         size_t accessRange, bool isShowEachResponse, bool isShowHistogram,
-        size_t flushInterval, size_t ignorePeriod, const HistogramConfig& histogramCfg)
-        : blockSize_(blockSize)
+        size_t flushInterval, size_t ignorePeriod, size_t readPct,
+        const HistogramConfig& histogramCfg, const AsyncIoConfig& asyncIoCfg,
+        size_t batchSize, const TrimConfig& trimCfg,
+        const VectorConfig& vectorCfg, const DistConfig& distCfg, bool isRecordAccess,
+        const Throttle& throttle, uint64_t seed)
+        : threadId_(threadId)
+        , bsSplit_(bsSplit)
+        , blockSize_(bsSplit.getMin())
         , queueSize_(queueSize)
-        , accessRange_(calcAccessRange(accessRange, blockSize, dev))
+        , accessRange_(checkAccessRange(calcAccessRange(accessRange, blockSize_, targets), bsSplit))
         , isShowEachResponse_(isShowEachResponse)
         , isShowHistogram_(isShowHistogram)
         , flushInterval_(flushInterval)
         , ignorePeriod_(ignorePeriod)
-        , mode_(dev.getMode())
-        , bb_(queueSize * 2, blockSize)
-        , rand_(0, std::numeric_limits<size_t>::max())
+        , readPct_(readPct)
+        , mode_(mode)
+        , batchSize_(batchSize)
+        , trimCfg_(trimCfg)
+        , targets_(targets)
+        , bb_(queueSize * 2, bsSplit.getMax())
+        , iovBuf_(queueSize * 2, blockSize_, vectorCfg, Xoshiro256::stream(seed, threadId * 3 + 2))
+        , rand_(Xoshiro256::stream(seed, threadId * 3))
         , logQ_()
-        , histograms_(generateHistogram(histogramCfg))
+        , histograms_(isShowHistogram ? generateHistogram(histogramCfg, bsSplit.getNr())
+                      : std::vector<Histogram>())
         , stat_()
-        , aio_(dev.getFd(), queueSize)
-        , bgnTime_(0) {
+        , typeStats_(4)
+        , sizeStats_(bsSplit.getNr())
+        , targetStats_(nrTargets > 1 ? nrTargets : 0)
+        , nrFlushes_(0)
+        , serviceStat_()
+        , lagStat_()
+        , nrLate_(0)
+        , lateThreshold_(0)
+        , dist_(distCfg, accessRange_, Xoshiro256::stream(seed, threadId * 3 + 1))
+        , accessStat_()
+        , isRecordAccess_(isRecordAccess)
+        , throttle_(throttle)
+        , aio_(targets.getFds(), queueSize, asyncIoCfg)
+        , bgnTime_(0)
+        , doneV_()
+        , reapStat_(batchSize)
+        , submitStat_(queueSize) {
 
         assert(blockSize_ % 512 == 0);
         assert(queueSize_ > 0);
+        assert(0 < batchSize_ && batchSize_ <= queueSize_);
         assert(accessRange_ > 0);
+        aio_.registerBuffers(bb_.getIovecs());
+        if (isRecordAccess_ && !distCfg.isCoverageKnown()) {
+            accessStat_.setRange(targets.getNr() == 1 ? targets.getId(0) : 0, accessRange_);
+        }
     }
 
     void execNtimes(size_t nTimes) {
@@ -623,24 +985,29 @@ public:
             pending++;
             c++;
         }
-        aio_.submit();
+        submit(pending);
         // Wait and fill.
         while (c < nTimes) {
             assert(pending == queueSize_);
 
-            waitAnIo();
-            pending--;
-
-            bool isFlush = flushInterval_ > 0 &&
-                c % flushInterval_ == flushInterval_ - 1;
-            if (isFlush) {
-                prepareFlush();
-            } else {
-                prepareIo(bb_.next());
+            double end;
+            const size_t nr = waitIos(end);
+            pending -= nr;
+
+            size_t i = 0;
+            while (i < nr && c < nTimes) {
+                bool isFlush = flushInterval_ > 0 &&
+                    c % flushInterval_ == flushInterval_ - 1;
+                if (isFlush) {
+                    prepareFlush();
+                } else {
+                    prepareIo(bb_.next());
+                }
+                pending++;
+                c++;
+                i++;
             }
-            pending++;
-            c++;
-            aio_.submit();
+            submit(i);
         }
         // Wait remaining.
         while (pending > 0) {
@@ -661,25 +1028,77 @@ public:
             pending++;
             c++;
         }
-        aio_.submit();
+        submit(pending);
         // Wait and fill.
         while (end - bgnTime_ < static_cast<double>(nSecs)) {
             assert(pending == queueSize_);
 
-            end = waitAnIo();
+            const size_t nr = waitIos(end);
+            pending -= nr;
+
+            for (size_t i = 0; i < nr; i++) {
+                bool isFlush = flushInterval_ > 0 &&
+                    c % flushInterval_ == flushInterval_ - 1;
+                if (isFlush) {
+                    prepareFlush();
+                } else {
+                    prepareIo(bb_.next());
+                }
+                pending++;
+                c++;
+            }
+            submit(nr);
+        }
+        // Wait pending.
+        while (pending > 0) {
+            waitAnIo();
             pending--;
+        }
+    }
 
-            bool isFlush = flushInterval_ > 0 &&
-                c % flushInterval_ == flushInterval_ - 1;
-            if (isFlush) {
-                prepareFlush();
-            } else {
-                prepareIo(bb_.next());
-            }
+    /**
+     * Issue IOs at the arrival times of cfg (open loop) instead of
+     * at completions of others. Responses are measured from the arrival times,
+     * so stalls of the device show up as queueing delay
+     * instead of being hidden by a slower issue rate (coordinated omission).
+     * IOs that cannot be issued because the queue is full are delayed
+     * and counted as late when they miss their time by more than an interval.
+     * @nTimes number of IOs. 0 means to run nSecs.
+     */
+    void execOpenLoop(const ArrivalConfig& cfg, size_t nTimes, size_t nSecs) {
+        bgnTime_ = getTime();
+        lateThreshold_ = cfg.getInterval();
+        double next = bgnTime_; /* scheduled time of the next IO. */
+        size_t c = 0;
+        size_t pending = 0;
 
-            pending++;
-            c++;
-            aio_.submit();
+        for (;;) {
+            const double now = getTime();
+            if (nTimes > 0 ? c >= nTimes : now - bgnTime_ >= static_cast<double>(nSecs)) {
+                break;
+            }
+            size_t nr = 0;
+            while (next <= now && pending < queueSize_ && (nTimes == 0 || c < nTimes)) {
+                bool isFlush = flushInterval_ > 0 &&
+                    c % flushInterval_ == flushInterval_ - 1;
+                if (isFlush) {
+                    prepareFlush(next);
+                } else {
+                    prepareIo(bb_.next(), next);
+                }
+                next += cfg.next(rand_);
+                pending++;
+                c++;
+                nr++;
+            }
+            if (nr > 0) submit(nr);
+            if (pending == 0) {
+                waitUntil(next);
+                continue;
+            }
+            /* Wake up at the next arrival unless no more IO can be issued. */
+            const double timeout = pending == queueSize_ ? -1.0 : std::max(0.0, next - getTime());
+            pending -= waitIosFor(timeout);
         }
         // Wait pending.
         while (pending > 0) {
@@ -689,8 +1108,19 @@ public:
     }
 
     PerformanceStatistics& getStat() { return stat_; }
+    const std::vector<PerformanceStatistics>& getTypeStats() const { return typeStats_; }
+    const PerformanceStatistics& getServiceStat() const { return serviceStat_; }
+    const PerformanceStatistics& getLagStat() const { return lagStat_; }
+    size_t getNrLate() const { return nrLate_; }
+    const std::vector<PerformanceStatistics>& getSizeStats() const { return sizeStats_; }
+    const TargetStatistics& getTargetStats() const { return targetStats_; }
     std::queue<IoLog>& getIoLogQueue() { return logQ_; }
     const std::vector<Histogram>& getHistograms() const { return histograms_; }
+    const BatchStatistics& getReapStat() const { return reapStat_; }
+    const BatchStatistics& getSubmitStat() const { return submitStat_; }
+    const AccessStatistics& getAccessStat() const { return accessStat_; }
+    size_t getAccessRange() const { return accessRange_; }
+    BlockDistribution& getDistribution() { return dist_; }
 
 private:
     bool decideIsWrite() {
@@ -704,7 +1134,7 @@ private:
             isWrite = true;
             break;
         case MIX_MODE:
-            isWrite = rand_.get(2) == 0;
+            isWrite = rand_.get(100) >= readPct_;
             break;
         default:
             assert(false);
@@ -712,84 +1142,1050 @@ private:
         return isWrite;
     }
 
-    void prepareIo(char *buf) {
-        size_t blockId = rand_.get(accessRange_);
-
-        if (decideIsWrite()) {
-            aio_.prepareWrite(blockId * blockSize_, blockSize_, buf);
+    /**
+     * @scheduled intended issue time in open-loop runs. 0 means none.
+     */
+    void prepareIo(char *buf, double scheduled = 0.0) {
+        size_t blockId = dist_.get();
+        if (isRecordAccess_) accessStat_.add(blockId);
+        const size_t size = bsSplit_.pick(rand_);
+        const std::pair<size_t, uint64_t> loc =
+            targets_.locate(bsSplit_.getOffset(blockId, size, accessRange_));
+        const off_t oft = loc.second;
+        aio_.selectFile(loc.first);
+        throttle_.acquire(size);
+
+        const int nrSegs = iovBuf_.getNrSegs();
+        if (trimCfg_.isEnabled() && rand_.get(100) < trimCfg_.pct) {
+            aio_.prepareTrim(trimCfg_.kind, oft, size);
+        } else if (nrSegs > 0) {
+            if (decideIsWrite()) {
+                aio_.prepareWritev(oft, iovBuf_.next(), nrSegs);
+            } else {
+                aio_.prepareReadv(oft, iovBuf_.next(), nrSegs);
+            }
+        } else if (decideIsWrite()) {
+            aio_.prepareWrite(oft, size, buf);
         } else {
-            aio_.prepareRead(blockId * blockSize_, blockSize_, buf);
+            aio_.prepareRead(oft, size, buf);
+        }
+        if (scheduled > 0) aio_.setScheduledTime(scheduled);
+        submitIfPaced();
+    }
+
+    /**
+     * With a cap, submit the IO prepared just now as soon as its token is granted.
+     * Otherwise it would wait for the tokens of the rest of the batch,
+     * and the paced IOs would go out in bursts.
+     */
+    void submitIfPaced() {
+        if (!throttle_.isEnabled()) return;
+        aio_.submit();
+        if (batchSize_ > 1) {
+            submitStat_.add(1);
         }
     }
 
     double waitAnIo() {
-        auto* ptr = aio_.waitOne();
+        return recordIo(aio_.waitOne());
+    }
+
+    /**
+     * Wait at least one and at most batchSize_ IO(s).
+     * @end the end time of the IOs will be set.
+     * @return number of completed IOs.
+     */
+    size_t waitIos(double& end) {
+        if (batchSize_ == 1) {
+            end = waitAnIo();
+            return 1;
+        }
+        const size_t nr = aio_.waitSome(batchSize_, doneV_);
+        for (AioData *ptr : doneV_) {
+            end = recordIo(ptr);
+        }
+        reapStat_.add(nr);
+        return nr;
+    }
+
+    /**
+     * Wait at most batchSize_ IO(s) until timeout.
+     * @timeout [sec]. negative means to wait at least one IO.
+     * @return number of completed IOs.
+     */
+    size_t waitIosFor(double timeout) {
+        const size_t nr = aio_.waitSome(batchSize_, doneV_, timeout);
+        for (AioData *ptr : doneV_) {
+            recordIo(ptr);
+        }
+        if (nr > 0 && batchSize_ > 1) {
+            reapStat_.add(nr);
+        }
+        return nr;
+    }
+
+    /**
+     * Submit prepared IOs.
+     * @nr number of the IOs.
+     */
+    void submit(size_t nr) {
+        aio_.submit();
+        /*
+         * submit(0) only flushes leftovers and is not a batch,
+         * and paced IOs have been submitted one by one.
+         */
+        if (nr > 0 && batchSize_ > 1 && !throttle_.isEnabled()) {
+            submitStat_.add(nr);
+        }
+    }
+
+    /**
+     * @return end time of the IO.
+     */
+    double recordIo(AioData *ptr) {
         auto log = toIoLog(ptr);
         if (ptr->endTime  - bgnTime_ > static_cast<double>(ignorePeriod_)) {
             stat_.updateRt(log.response);
-            addToHistogram(log);
+            typeStats_[log.type].updateRt(log.response);
+            const size_t sizeIdx = getSizeIndex(ptr);
+            if (bsSplit_.isSplit() && ptr->size > 0) sizeStats_[sizeIdx].updateRt(log.response);
+            if (targetStats_.isEnabled() && ptr->size > 0) {
+                targetStats_.add(targets_.getId(ptr->fileIdx), ptr->size, log.response);
+            }
+            addToHistogram(log, sizeIdx);
             if (isShowEachResponse_) logQ_.push(log);
+            if (ptr->scheduledTime > 0) addToArrivalStat(ptr);
         }
         return ptr->endTime;
     }
 
-    void prepareFlush() {
+    /**
+     * Each flush goes to the next target in turn.
+     * @scheduled intended issue time in open-loop runs. 0 means none.
+     */
+    void prepareFlush(double scheduled = 0.0) {
+        throttle_.acquire(0);
+        aio_.selectFile(nrFlushes_++ % targets_.getNr());
         aio_.prepareFlush();
+        if (scheduled > 0) aio_.setScheduledTime(scheduled);
+        submitIfPaced();
     }
 
+    /**
+     * @return index of the IO size. flush IOs go to 0.
+     */
+    size_t getSizeIndex(const AioData *ptr) const {
+        if (!bsSplit_.isSplit() || ptr->size == 0) return 0;
+        return bsSplit_.getIndex(ptr->size);
+    }
+    void addToArrivalStat(const AioData *ptr) {
+        const double lag = ptr->beginTime - ptr->scheduledTime;
+        serviceStat_.updateRt(ptr->endTime - ptr->beginTime);
+        lagStat_.updateRt(lag);
+        if (lag > lateThreshold_) nrLate_++;
+    }
+
+    /**
+     * IOs in open loop start at their scheduled time.
+     */
     IoLog toIoLog(AioData *ptr) {
-        return IoLog(0, ptr->type, ptr->oft / ptr->size,
-                     ptr->beginTime, ptr->endTime - ptr->beginTime);
+        const double start = ptr->scheduledTime > 0 ? ptr->scheduledTime : ptr->beginTime;
+        return IoLog(threadId_, ptr->type, ptr->size == 0 ? 0 : ptr->oft / blockSize_,
+                     start, ptr->endTime - start);
     }
-    void addToHistogram(const IoLog& log) {
+    void addToHistogram(const IoLog& log, size_t sizeIdx) {
         if (!isShowHistogram_) return;
-        ::addToHistogram(histograms_, log);
+        ::addToHistogram(histograms_, log, sizeIdx);
     }
 };
 
-void execAioExperiment(const Options& opt)
+/**
+ * Results of a worker thread.
+ */
+struct WorkerResult
 {
-    assert(opt.getNthreads() == 0);
-    const size_t queueSize = opt.getQueueSize();
-    assert(queueSize > 0);
+    std::queue<IoLog> logQ;
+    std::vector<Histogram> histograms;
+    PerformanceStatistics stat;
+    PerformanceStatistics hitStat; /* reads regarded as page cache hits. */
+    PerformanceStatistics missStat; /* reads regarded as page cache misses. */
+    std::vector<PerformanceStatistics> typeStats; /* indexed by IoType. */
+    std::vector<PerformanceStatistics> sizeStats; /* indexed as Options::bsSplit.sizes. */
+    PerformanceStatistics serviceStat; /* open loop only. */
+    PerformanceStatistics lagStat; /* open loop only. */
+    size_t nrLate = 0; /* open loop only. */
+    AccessStatistics accessStat;
+    TargetStatistics targetStats; /* empty with a target. */
+};
 
-    const bool isDirect = true;
-    BlockDevice bd(opt.getArgs()[0], opt.getMode(), isDirect);
+/**
+ * Give a thread its own partition of -z perm or seq.
+ * With thread placement, only the threads sharing a target split it.
+ */
+void setPartition(const Options& opt, BlockDistribution& dist, size_t threadId)
+{
+    size_t idx = threadId;
+    size_t nr = opt.getNthreads();
+    if (opt.placementCfg.type == PLACE_THREAD) {
+        const size_t nrTargets = opt.getArgs().size();
+        idx = threadId / nrTargets;
+        nr = (nr - threadId % nrTargets + nrTargets - 1) / nrTargets;
+    }
+    dist.setPartition(opt.getSeed(), idx, nr);
+}
 
-    AioResponseBench bench(bd, opt.getBlockSize(), opt.getQueueSize(),
-                           opt.getAccessRange(),
-                           opt.isShowEachResponse(),
-                           opt.isShowHistogram(),
+void do_work(int threadId, const Options& opt, WorkerResult& res, std::mutex& mutex)
+{
+    const bool isDirect = !opt.dontUseOdirect();;
+
+    TargetSet targets(opt.getArgs(), opt.getMode(), isDirect, opt.placementCfg, threadId);
+    if (opt.getEngine() == ENGINE_PVSYNC2) {
+        targets.setPositional(opt.getRwFlags());
+    } else if (opt.getEngine() == ENGINE_MMAP) {
+        targets.setMmap(opt.mmapCfg);
+    }
+
+    const double hitThreshold = opt.isCacheCfgSet() ?
+        static_cast<double>(opt.cacheCfg.hitUsec) / 1000000.0 : -1.0;
+    IoResponseBench bench(threadId, targets, opt.bsSplit, opt.getAccessRange(),
+                          res.logQ, res.histograms, res.stat, res.hitStat, res.missStat,
+                          res.sizeStats, res.targetStats,
+                          opt.isShowEachResponse(), opt.isShowHistogram(), hitThreshold,
+                          opt.getFlushInterval(), opt.getIgnorePeriod(), opt.getReadPct(),
+                          opt.vectorCfg, opt.distCfg,
+                          opt.isDistCfgSet() ? &res.accessStat : nullptr,
+                          opt.getThrottle(), opt.getSeed());
+    if (opt.distCfg.isPartitioned()) {
+        setPartition(opt, bench.getDistribution(), threadId);
+    }
+    const FaultCount fltBgn = FaultCount::getThread();
+    if (opt.getPeriod() > 0) {
+        bench.execNsecs(opt.getPeriod());
+    } else {
+        bench.execNtimes(opt.getCount());
+    }
+    const FaultCount fltEnd = FaultCount::getThread();
+    const std::string prefix = opt.getIdPrefix();
+    std::lock_guard<std::mutex> lk(mutex);
+    ::printf("%sid %d ", prefix.c_str(), threadId);
+    res.stat.print();
+    if (opt.getRwFlags() & RWF_NOWAIT) {
+        ::printf("%sid %d EAGAIN %zu\n", prefix.c_str(), threadId, targets.getNrAgain());
+    }
+    if (opt.getEngine() == ENGINE_MMAP) {
+        ::printf("%sid %d majflt %zu minflt %zu\n", prefix.c_str(), threadId,
+                 fltEnd.major - fltBgn.major, fltEnd.minor - fltBgn.minor);
+    }
+}
+
+
+/**
+ * Worker with its own aio context and buffers.
+ */
+template <typename AsyncIo>
+void do_aio_work(int threadId, const Options& opt, WorkerResult& res, std::mutex& mutex)
+{
+    const bool isDirect = true;
+    TargetSet targets(opt.getArgs(), opt.getOpenMode(), isDirect, opt.placementCfg, threadId);
+
+    AioResponseBench<AsyncIo> bench(threadId, targets, opt.getArgs().size(), opt.getMode(),
+                                    opt.bsSplit, opt.getQueueSize(),
+                                    opt.getAccessRange(),
+                                    opt.isShowEachResponse(),
+                                    opt.isShowHistogram(),
+                                    opt.getFlushInterval(),
+                                    opt.getIgnorePeriod(),
+                                    opt.getReadPct(),
+                                    opt.histogramCfg,
+                                    opt.asyncIoCfg,
+                                    opt.getBatchSize(),
+                                    opt.trimCfg,
+                                    opt.vectorCfg,
+                                    opt.distCfg,
+                                    opt.isDistCfgSet(),
+                                    opt.getThrottle(),
+                                    opt.getSeed());
+    if (opt.distCfg.isPartitioned()) {
+        setPartition(opt, bench.getDistribution(), threadId);
+    }
+    if (opt.arrivalCfg.isEnabled()) {
+        ArrivalConfig arrivalCfg = opt.arrivalCfg;
+        arrivalCfg.rate /= opt.getNthreads();
+        bench.execOpenLoop(arrivalCfg, opt.getCount(), opt.getPeriod());
+    } else if (opt.getPeriod() > 0) {
+        bench.execNsecs(opt.getPeriod());
+    } else {
+        bench.execNtimes(opt.getCount());
+    }
+    res.logQ = std::move(bench.getIoLogQueue());
+    res.histograms = bench.getHistograms();
+    res.stat = bench.getStat();
+    res.typeStats = bench.getTypeStats();
+    res.sizeStats = bench.getSizeStats();
+    res.serviceStat = bench.getServiceStat();
+    res.lagStat = bench.getLagStat();
+    res.nrLate = bench.getNrLate();
+    res.accessStat = bench.getAccessStat();
+    res.targetStats = bench.getTargetStats();
+
+    std::lock_guard<std::mutex> lk(mutex);
+    ::printf("%sid %d ", opt.getIdPrefix().c_str(), threadId);
+    res.stat.print();
+}
+
+
+void worker_start(std::vector<std::future<void> >& workers, size_t nr, const Options& opt,
+                  std::vector<WorkerResult>& results, std::mutex& mutex)
+{
+    results.resize(nr);
+    const size_t nrTargets = opt.getArgs().size();
+    for (WorkerResult& res : results) {
+        res.sizeStats.resize(opt.bsSplit.getNr());
+        if (nrTargets > 1) res.targetStats = TargetStatistics(nrTargets);
+        if (opt.isShowHistogram()) {
+            res.histograms = generateHistogram(opt.histogramCfg, opt.bsSplit.getNr());
+        }
+    }
+    decltype(&do_work) func = do_work;
+    if (opt.isAioPerThread()) {
+        if (opt.getEngine() == ENGINE_URING) {
+            func = do_aio_work<IoUring>;
+        } else {
+            func = do_aio_work<Aio>;
+        }
+    }
+    opt.affinityCfg.print(nr, opt.getIdPrefix() + "id");
+    for (size_t i = 0; i < nr; i++) {
+        std::future<void> f = std::async(std::launch::async, [func, i, &opt, &results, &mutex] {
+                /* before the worker allocates its buffers. */
+                opt.affinityCfg.place(i);
+                func(i, opt, results[i], mutex);
+            });
+        workers.push_back(std::move(f));
+    }
+}
+
+void worker_join(std::vector<std::future<void> >& workers)
+{
+    std::for_each(workers.begin(), workers.end(),
+                  [](std::future<void>& f) { f.get(); });
+}
+
+void pop_and_show_logQ(std::queue<IoLog>& logQ)
+{
+    while (! logQ.empty()) {
+        IoLog& log = logQ.front();
+        log.print();
+        logQ.pop();
+    }
+}
+
+/**
+ * Print statistics of each IO type that occurred.
+ * @stats indexed by IoType.
+ */
+void printTypeStats(const std::vector<PerformanceStatistics>& stats)
+{
+    const char *const names[] = {"read", "write", "flush", "trim"};
+    for (size_t i = 0; i < stats.size(); i++) {
+        if (stats[i].getCount() == 0) continue;
+        ::printf("%s ", names[i]);
+        stats[i].print();
+    }
+}
+
+/**
+ * Print how open-loop IOs kept up with their schedule.
+ * @interval mean interval between arrivals of a worker [sec].
+ */
+void printArrivalStat(const PerformanceStatistics& serviceStat,
+                      const PerformanceStatistics& lagStat, size_t nrLate, double interval)
+{
+    ::printf("service ");
+    serviceStat.print();
+    ::printf("lag ");
+    lagStat.print();
+    const size_t nr = lagStat.getCount();
+    ::printf("Late: %zu / %zu IOs (%.2f%%) issued more than %.3f us behind schedule.\n",
+             nrLate, nr, nr == 0 ? 0.0 : 100.0 * nrLate / nr, interval * 1000000.0);
+}
+
+/**
+ * Set page cache state of the access range before the run.
+ * @accessSize [byte]
+ */
+void prepareCache(const BlockDevice& bd, const CacheConfig& cfg, size_t accessSize)
+{
+    if (cfg.isDrop) {
+        dropPageCache(bd);
+    }
+    if (cfg.warmPct > 0) {
+        warmPageCache(bd, accessSize * cfg.warmPct / 100);
+    }
+}
+
+/**
+ * Print read responses split into likely page cache hits and misses,
+ * and page cache residency of the access range after the run.
+ * @accessSize [byte]
+ */
+void printCacheStat(const Options& opt, size_t accessSize,
+                    const std::vector<WorkerResult>& results)
+{
+    std::vector<PerformanceStatistics> hitStats, missStats;
+    for (const WorkerResult& res : results) {
+        hitStats.push_back(res.hitStat);
+        missStats.push_back(res.missStat);
+    }
+    PerformanceStatistics hitStat = mergeStats(hitStats.begin(), hitStats.end());
+    PerformanceStatistics missStat = mergeStats(missStats.begin(), missStats.end());
+    ::printf("hit ");
+    hitStat.print();
+    ::printf("miss ");
+    missStat.print();
+    const size_t nrReads = hitStat.getCount() + missStat.getCount();
+    ::printf("Hit ratio: %.2f%% (%zu / %zu reads below %zu us).\n",
+             nrReads == 0 ? 0.0 : 100.0 * hitStat.getCount() / nrReads,
+             hitStat.getCount(), nrReads, opt.cacheCfg.hitUsec);
+
+    BlockDevice bd(opt.getArgs()[0], READ_MODE, false);
+    size_t resident, total;
+    std::tie(resident, total) = countResidentPages(bd, accessSize);
+    ::printf("Cache: resident %zu / %zu pages (%.2f%%).\n",
+             resident, total, total == 0 ? 0.0 : 100.0 * resident / total);
+}
+
+/**
+ * Prepare page cache with -C.
+ * @return access size [byte], or 0 without -C.
+ */
+size_t setupCache(const Options& opt)
+{
+    if (!opt.isCacheCfgSet()) return 0;
+    BlockDevice bd(opt.getArgs()[0], READ_MODE, false);
+    const size_t accessSize = opt.getBlockSize() *
+        calcAccessRange(opt.getAccessRange(), opt.getBlockSize(), bd);
+    prepareCache(bd, opt.cacheCfg, accessSize);
+    return accessSize;
+}
+
+/**
+ * Number of blocks which all the threads access.
+ * With thread placement, the ranges of the targets in use are summed up.
+ */
+uint64_t calcTotalAccessRange(const Options& opt)
+{
+    const size_t nr = opt.placementCfg.type == PLACE_THREAD ?
+        std::min(opt.getNthreads(), opt.getArgs().size()) : 1;
+    uint64_t total = 0;
+    for (size_t i = 0; i < nr; i++) {
+        TargetSet targets(opt.getArgs(), READ_MODE, false, opt.placementCfg, i);
+        total += calcAccessRange(opt.getAccessRange(), opt.getBlockSize(), targets);
+    }
+    return total;
+}
+
+/**
+ * Print accesses of blocks with -z.
+ * @n number of blocks in the range.
+ */
+void printAccessStat(const Options& opt, const AccessStatistics& accessStat, uint64_t n)
+{
+    if (opt.distCfg.isCoverageKnown()) {
+        /* the partitions of the threads make up the range, so passes tell the coverage. */
+        const uint64_t nrIos = accessStat.getNrIos();
+        ::printf("Access: %s %" PRIu64 " IOs / %" PRIu64 " blocks"
+                 " %" PRIu64 " passes and %.2f%% of the next.\n",
+                 opt.distCfg.type == DIST_SEQ ? "seq" : "perm", nrIos, n,
+                 n == 0 ? 0 : nrIos / n, n == 0 ? 0.0 : 100.0 * (nrIos % n) / n);
+        return;
+    }
+    accessStat.print(n);
+}
+
+/**
+ * Print the results of threads.
+ * @period measured period [sec].
+ * @accessSize returned by setupCache().
+ * @return total bytes of the IOs.
+ */
+uint64_t printThreadResults(const Options& opt, std::vector<WorkerResult>& results,
+                            double period, size_t accessSize)
+{
+    const size_t nthreads = results.size();
+    for (WorkerResult& res : results) {
+        pop_and_show_logQ(res.logQ);
+    }
+
+    if (opt.isShowHistogram()) {
+        std::vector<Histogram> hsTotal = generateHistogram(opt.histogramCfg, opt.bsSplit.getNr());
+        for (const WorkerResult& res : results) {
+            for (size_t i = 0; i < hsTotal.size(); i++) {
+                hsTotal[i].merge(res.histograms[i]);
+            }
+        }
+        printHistograms(hsTotal, opt.bsSplit);
+    }
+
+    std::vector<PerformanceStatistics> stats;
+    for (const WorkerResult& res : results) stats.push_back(res.stat);
+    PerformanceStatistics stat = mergeStats(stats.begin(), stats.end());
+    ::printf("---------------\n");
+    if (opt.trimCfg.isEnabled()) {
+        std::vector<PerformanceStatistics> typeStats;
+        for (size_t i = 0; i < 4; i++) {
+            std::vector<PerformanceStatistics> v;
+            for (const WorkerResult& res : results) v.push_back(res.typeStats[i]);
+            typeStats.push_back(mergeStats(v.begin(), v.end()));
+        }
+        printTypeStats(typeStats);
+    }
+    uint64_t bytes = opt.getBlockSize() * stat.getCount();
+    if (opt.bsSplit.isSplit()) {
+        std::vector<PerformanceStatistics> sizeStats;
+        for (size_t i = 0; i < opt.bsSplit.getNr(); i++) {
+            std::vector<PerformanceStatistics> v;
+            for (const WorkerResult& res : results) v.push_back(res.sizeStats[i]);
+            sizeStats.push_back(mergeStats(v.begin(), v.end()));
+        }
+        bytes = printSizeStats(opt.bsSplit, sizeStats, period);
+    }
+    if (opt.arrivalCfg.isEnabled()) {
+        std::vector<PerformanceStatistics> serviceStats, lagStats;
+        size_t nrLate = 0;
+        for (const WorkerResult& res : results) {
+            serviceStats.push_back(res.serviceStat);
+            lagStats.push_back(res.lagStat);
+            nrLate += res.nrLate;
+        }
+        printArrivalStat(mergeStats(serviceStats.begin(), serviceStats.end()),
+                         mergeStats(lagStats.begin(), lagStats.end()), nrLate,
+                         nthreads / opt.arrivalCfg.rate);
+    }
+    ::printf("all ");
+    stat.print();
+    if (period > 0) {
+        printDataThroughput(bytes, stat.getCount(), period);
+    } else {
+        printZeroThroughput();
+    }
+    if (opt.getArgs().size() > 1) {
+        TargetStatistics targetStats;
+        for (const WorkerResult& res : results) targetStats.merge(res.targetStats);
+        targetStats.print(opt.getArgs(), period);
+    }
+    if (opt.isCacheCfgSet()) {
+        printCacheStat(opt, accessSize, results);
+    }
+    if (opt.isDistCfgSet()) {
+        AccessStatistics accessStat;
+        for (const WorkerResult& res : results) accessStat.merge(res.accessStat);
+        printAccessStat(opt, accessStat, calcTotalAccessRange(opt));
+    }
+    return bytes;
+}
+
+void execThreadExperiment(const Options& opt)
+{
+    const size_t nthreads = opt.getNthreads();
+    assert(nthreads > 0);
+
+    std::vector<WorkerResult> results;
+    std::vector<std::future<void> > workers;
+    std::mutex mutex;
+
+    const size_t accessSize = setupCache(opt);
+
+    const double bgn = getTime();
+    worker_start(workers, nthreads, opt, results, mutex);
+    worker_join(workers);
+    const double end = getTime();
+
+    assert(results.size() == nthreads);
+    const double period =
+        end - bgn - static_cast<double>(opt.getIgnorePeriod());
+    printThreadResults(opt, results, period, accessSize);
+}
+
+/**
+ * A job of a job file.
+ */
+struct Job
+{
+    std::string name;
+    Options opt;
+    std::vector<WorkerResult> results;
+    std::vector<std::future<void> > workers;
+    double end; /* time when the last worker finished. */
+
+    Job(const std::string& name0, const Options& opt0)
+        : name(name0), opt(opt0), results(), workers(), end(0) {}
+};
+
+/**
+ * Load a job file.
+ * Each line is 'name: options target', and '#' starts a comment.
+ */
+std::vector<Job> loadJobs(const std::string& path)
+{
+    std::ifstream is(path);
+    if (!is) {
+        throw std::runtime_error(formatString("could not open %s.", path.c_str()));
+    }
+    std::vector<Job> jobs;
+    std::string line;
+    while (std::getline(is, line)) {
+        line = line.substr(0, line.find('#'));
+        const size_t pos = line.find(':');
+        std::vector<std::string> tokens;
+        std::istringstream ss(pos == std::string::npos ? line : line.substr(pos + 1));
+        std::string token;
+        while (ss >> token) tokens.push_back(token);
+        std::string name;
+        if (pos != std::string::npos) {
+            std::istringstream(line.substr(0, pos)) >> name;
+        }
+        if (name.empty()) {
+            if (tokens.empty() && pos == std::string::npos) continue;
+            throw std::runtime_error(formatString("job name is missing: %s", line.c_str()));
+        }
+        for (const Job& job : jobs) {
+            if (job.name == name) {
+                throw std::runtime_error(formatString("job %s is duplicated.", name.c_str()));
+            }
+        }
+        std::vector<char*> argv;
+        std::string programName("iores");
+        argv.push_back(&programName[0]);
+        for (std::string& t : tokens) argv.push_back(&t[0]);
+        argv.push_back(nullptr);
+        try {
+            Options opt(argv.size() - 1, argv.data());
+            if (opt.isShowHelp() || opt.isShowVersion() || opt.isJobFile() ||
+                opt.isReplay() || opt.getNthreads() == 0) {
+                throw std::runtime_error("-h, -v, -J, -P, and -t 0 are not allowed in a job.");
+            }
+            opt.setJobName(name);
+            jobs.emplace_back(name, opt);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(formatString("job %s: %s", name.c_str(), e.what()));
+        }
+    }
+    if (jobs.empty()) {
+        throw std::runtime_error(formatString("no job found in %s.", path.c_str()));
+    }
+    return jobs;
+}
+
+/**
+ * Run all the jobs of a job file at the same time.
+ * Each job is reported like a run without -J, and then all the jobs together.
+ */
+void execJobExperiment(const Options& opt)
+{
+    std::vector<Job> jobs = loadJobs(opt.getJobPath());
+    std::vector<size_t> accessSizes;
+    for (const Job& job : jobs) accessSizes.push_back(setupCache(job.opt));
+
+    std::mutex mutex;
+    const double bgn = getTime();
+    for (Job& job : jobs) {
+        worker_start(job.workers, job.opt.getNthreads(), job.opt, job.results, mutex);
+    }
+    std::vector<std::future<void> > waiters;
+    for (Job& job : jobs) {
+        waiters.push_back(std::async(std::launch::async, [&job]() {
+                    worker_join(job.workers);
+                    job.end = getTime();
+                }));
+    }
+    worker_join(waiters);
+    const double end = getTime();
+
+    std::vector<PerformanceStatistics> stats;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        Job& job = jobs[i];
+        ::printf("=============== job %s\n", job.name.c_str());
+        const double period =
+            job.end - bgn - static_cast<double>(job.opt.getIgnorePeriod());
+        bytes += printThreadResults(job.opt, job.results, period, accessSizes[i]);
+        std::vector<PerformanceStatistics> v;
+        for (const WorkerResult& res : job.results) v.push_back(res.stat);
+        stats.push_back(mergeStats(v.begin(), v.end()));
+    }
+    ::printf("=============== all jobs\n");
+    for (size_t i = 0; i < jobs.size(); i++) {
+        ::printf("%s ", jobs[i].name.c_str());
+        stats[i].print();
+    }
+    PerformanceStatistics stat = mergeStats(stats.begin(), stats.end());
+    ::printf("all ");
+    stat.print();
+    printDataThroughput(bytes, stat.getCount(), end - bgn);
+}
+
+template <typename AsyncIo>
+void execAioExperiment(const Options& opt)
+{
+    assert(opt.getNthreads() == 0);
+    const size_t queueSize = opt.getQueueSize();
+    assert(queueSize > 0);
+    opt.affinityCfg.print(1, "id");
+    opt.affinityCfg.place(0);
+
+    const bool isDirect = true;
+    TargetSet targets(opt.getArgs(), opt.getOpenMode(), isDirect, opt.placementCfg, 0);
+
+    AioResponseBench<AsyncIo> bench(0, targets, opt.getArgs().size(), opt.getMode(),
+                           opt.bsSplit, opt.getQueueSize(),
+                           opt.getAccessRange(),
+                           opt.isShowEachResponse(),
+                           opt.isShowHistogram(),
                            opt.getFlushInterval(),
                            opt.getIgnorePeriod(),
-                           opt.histogramCfg);
+                           opt.getReadPct(),
+                           opt.histogramCfg,
+                           opt.asyncIoCfg,
+                           opt.getBatchSize(),
+                           opt.trimCfg,
+                           opt.vectorCfg,
+                           opt.distCfg,
+                           opt.isDistCfgSet(),
+                           opt.getThrottle(),
+                           opt.getSeed());
+    if (opt.distCfg.isPartitioned()) {
+        bench.getDistribution().setPartition(opt.getSeed(), 0, 1);
+    }
 
+    const CpuTime cpuBgn = CpuTime::getThread();
     const double bgn = getTime();
-    if (opt.getPeriod() > 0) {
+    if (opt.arrivalCfg.isEnabled()) {
+        bench.execOpenLoop(opt.arrivalCfg, opt.getCount(), opt.getPeriod());
+    } else if (opt.getPeriod() > 0) {
         bench.execNsecs(opt.getPeriod());
     } else {
         bench.execNtimes(opt.getCount());
     }
     const double end = getTime();
+    const CpuTime cpuEnd = CpuTime::getThread();
 
     pop_and_show_logQ(bench.getIoLogQueue());
 
     if (opt.isShowHistogram()) {
-        ::printf("HISTOGRAM BEGIN\n");
-        Histogram::joinAndPrint(bench.getHistograms());
-        ::printf("HISTOGRAM END\n");
+        printHistograms(bench.getHistograms(), opt.bsSplit);
     }
 
     auto& stat = bench.getStat();
-    ::printf("all ");
-    stat.print();
+    if (opt.trimCfg.isEnabled()) {
+        printTypeStats(bench.getTypeStats());
+    }
     const double period =
         end - bgn - static_cast<double>(opt.getIgnorePeriod());
+    uint64_t bytes = opt.getBlockSize() * stat.getCount();
+    if (opt.bsSplit.isSplit()) {
+        bytes = printSizeStats(opt.bsSplit, bench.getSizeStats(), period);
+    }
+    if (opt.arrivalCfg.isEnabled()) {
+        printArrivalStat(bench.getServiceStat(), bench.getLagStat(), bench.getNrLate(),
+                         opt.arrivalCfg.getInterval());
+    }
+    ::printf("all ");
+    stat.print();
     if (period > 0) {
-        printThroughput(opt.getBlockSize(), stat.getCount(), period);
+        printDataThroughput(bytes, stat.getCount(), period);
     } else {
         printZeroThroughput();
     }
+    printCpuTime(cpuBgn, cpuEnd, stat.getCount());
+    if (opt.getBatchSize() > 1) {
+        bench.getReapStat().print("Reap batch");
+        bench.getSubmitStat().print("Submit batch");
+    }
+    if (opt.getArgs().size() > 1) {
+        bench.getTargetStats().print(opt.getArgs(), period);
+    }
+    if (opt.isDistCfgSet()) {
+        printAccessStat(opt, bench.getAccessStat(), bench.getAccessRange());
+    }
+}
+
+/**
+ * Replay of the IOs of a thread in a trace with aio.
+ * AsyncIo is Aio or IoUring.
+ */
+template <typename AsyncIo>
+class ReplayBench
+{
+private:
+    const int threadId_;
+    const std::vector<TraceRecord> records_;
+    const size_t queueSize_;
+    const bool isFast_;
+    const bool isWrite_; /* replay writes as writes. */
+    const bool isTrim_; /* replay discards. */
+    const uint64_t devSize_; /* [byte] */
+    const bool isShowEachResponse_;
+    const size_t blockSize_; /* unit of block ids in IO logs. */
+
+    BlockBuffer bb_;
+    AsyncIo aio_;
+    std::queue<IoLog> logQ_;
+    PerformanceStatistics stat_;
+    std::vector<PerformanceStatistics> typeStats_; /* replayed, indexed by IoType. */
+    std::vector<PerformanceStatistics> recTypeStats_; /* recorded, indexed by IoType. */
+    PerformanceStatistics lagStat_;
+    uint64_t bytes_;
+    size_t nrSkipped_;
+    std::vector<AioData *> doneV_; /* temporal use for waitIosFor(). */
+
+public:
+    /**
+     * @records IOs of the thread.
+     * @isFast issue IOs as fast as possible instead of at their start times.
+     * @isWrite replay writes as writes instead of reads.
+     * @isTrim replay discards, or skip them.
+     * @blockSize unit of block ids in IO logs, which loadTrace() also uses.
+     */
+    ReplayBench(int threadId, const BlockDevice& dev, std::vector<TraceRecord>&& records,
+                size_t queueSize, bool isFast, bool isWrite, bool isTrim,
+                bool isShowEachResponse, size_t blockSize, const AsyncIoConfig& asyncIoCfg)
+        : threadId_(threadId)
+        , records_(std::move(records))
+        , queueSize_(queueSize)
+        , isFast_(isFast)
+        , isWrite_(isWrite)
+        , isTrim_(isTrim)
+        , devSize_(dev.getDeviceSize())
+        , isShowEachResponse_(isShowEachResponse)
+        , blockSize_(blockSize)
+        , bb_(queueSize * 2, getBufferSize(records_))
+        , aio_(dev.getFd(), queueSize, asyncIoCfg)
+        , logQ_()
+        , stat_()
+        , typeStats_(4)
+        , recTypeStats_(4)
+        , lagStat_()
+        , bytes_(0)
+        , nrSkipped_(0)
+        , doneV_() {
+
+        assert(queueSize_ > 0);
+        aio_.registerBuffers(bb_.getIovecs());
+    }
+
+    /**
+     * @nSecs stop issuing IOs after the seconds. 0 means no limit.
+     */
+    void run(size_t nSecs) {
+        const double bgn = getTime();
+        size_t i = 0;
+        size_t pending = 0;
+
+        while (i < records_.size()) {
+            const double now = getTime();
+            if (nSecs > 0 && now - bgn >= static_cast<double>(nSecs)) break;
+            size_t nr = 0;
+            while (i < records_.size() && pending < queueSize_) {
+                const TraceRecord& rec = records_[i];
+                const double scheduled = bgn + rec.startTime;
+                if (!isFast_ && scheduled > now) break;
+                i++;
+                if (!prepareIo(rec)) continue;
+                if (!isFast_) aio_.setScheduledTime(scheduled);
+                pending++;
+                nr++;
+            }
+            if (nr > 0) aio_.submit();
+            if (i == records_.size()) break;
+            if (pending == 0) {
+                waitUntil(bgn + records_[i].startTime);
+                continue;
+            }
+            /* Wake up at the next start time unless no more IO can be issued. */
+            const double timeout = isFast_ || pending == queueSize_ ? -1.0 :
+                std::max(0.0, bgn + records_[i].startTime - getTime());
+            pending -= waitIosFor(timeout);
+        }
+        while (pending > 0) {
+            pending -= waitIosFor(-1.0);
+        }
+    }
+
+    const PerformanceStatistics& getStat() const { return stat_; }
+    const std::vector<PerformanceStatistics>& getTypeStats() const { return typeStats_; }
+    const std::vector<PerformanceStatistics>& getRecordedTypeStats() const { return recTypeStats_; }
+    const PerformanceStatistics& getLagStat() const { return lagStat_; }
+    uint64_t getBytes() const { return bytes_; }
+    size_t getNrSkipped() const { return nrSkipped_; }
+    std::queue<IoLog>& getIoLogQueue() { return logQ_; }
+
+private:
+    static size_t getBufferSize(const std::vector<TraceRecord>& records) {
+        size_t size = 512;
+        for (const TraceRecord& rec : records) size = std::max(size, rec.size);
+        return (size + 511) / 512 * 512;
+    }
+
+    /**
+     * @return false if the IO is skipped.
+     */
+    bool prepareIo(const TraceRecord& rec) {
+        IoType type = rec.type;
+        if (rec.type == IOTYPE_FLUSH) {
+            aio_.prepareFlush();
+        } else if (rec.size == 0 || rec.size > devSize_ ||
+                   (rec.type == IOTYPE_DISCARD && !isTrim_)) {
+            nrSkipped_++;
+            return false;
+        } else {
+            /* Wrap around IOs beyond the target keeping 512-byte alignment. */
+            uint64_t oft = rec.oft;
+            if (oft + rec.size > devSize_) {
+                oft = oft % (devSize_ - rec.size + 1) / 512 * 512;
+            }
+            if (rec.type == IOTYPE_DISCARD) {
+                aio_.prepareTrim(TRIM_DISCARD, oft, rec.size);
+            } else if (rec.type == IOTYPE_WRITE && isWrite_) {
+                aio_.prepareWrite(oft, rec.size, bb_.next());
+            } else {
+                aio_.prepareRead(oft, rec.size, bb_.next());
+                type = IOTYPE_READ;
+            }
+        }
+        /* Compare with the recorded ones by the type as replayed. */
+        if (rec.response >= 0) recTypeStats_[type].updateRt(rec.response);
+        return true;
+    }
+
+    /**
+     * @timeout [sec]. negative means to wait at least one IO.
+     * @return number of completed IOs.
+     */
+    size_t waitIosFor(double timeout) {
+        const size_t nr = aio_.waitSome(queueSize_, doneV_, timeout);
+        for (AioData *ptr : doneV_) {
+            const double response = ptr->endTime - ptr->beginTime;
+            stat_.updateRt(response);
+            typeStats_[ptr->type].updateRt(response);
+            bytes_ += ptr->size;
+            if (ptr->scheduledTime > 0) lagStat_.updateRt(ptr->beginTime - ptr->scheduledTime);
+            if (isShowEachResponse_) {
+                logQ_.push(IoLog(threadId_, ptr->type, ptr->oft / blockSize_,
+                                 ptr->beginTime, response));
+            }
+        }
+        return nr;
+    }
+};
+
+/**
+ * Print recorded and replayed responses of each IO type.
+ */
+void printReplayComparison(const std::vector<PerformanceStatistics>& recStats,
+                           const std::vector<PerformanceStatistics>& stats)
+{
+    const char *const names[] = {"read", "write", "flush", "trim"};
+    for (size_t i = 0; i < stats.size(); i++) {
+        if (stats[i].getCount() == 0 && recStats[i].getCount() == 0) continue;
+        ::printf("recorded %s ", names[i]);
+        recStats[i].print();
+        ::printf("replayed %s ", names[i]);
+        stats[i].print();
+        if (recStats[i].getCount() > 0 && stats[i].getCount() > 0) {
+            ::printf("Ratio %s: replayed/recorded avg %.3f\n",
+                     names[i], stats[i].getAverage() / recStats[i].getAverage());
+        }
+    }
+}
+
+/**
+ * Replay a trace with a worker for each thread of the trace.
+ */
+template <typename AsyncIo>
+void execReplayExperiment(const Options& opt)
+{
+    typedef ReplayBench<AsyncIo> Bench;
+    std::vector<TraceRecord> trace = loadTrace(opt.getReplayPath(), opt.getBlockSize());
+    if (opt.getCount() > 0 && trace.size() > opt.getCount()) {
+        trace.resize(opt.getCount());
+    }
+    const size_t nr = getNrTraceThreads(trace);
+    std::vector<std::vector<TraceRecord> > perThread(nr);
+    bool hasWrite = false;
+    for (const TraceRecord& rec : trace) {
+        perThread[rec.threadId].push_back(rec);
+        if (rec.type == IOTYPE_WRITE || rec.type == IOTYPE_DISCARD) hasWrite = true;
+    }
+    const bool isWrite = opt.getMode() == WRITE_MODE;
+    const bool isTrim = isWrite && opt.getEngine() == ENGINE_URING;
+    ::printf("Replay: %zu IOs in %zu threads for %.3f sec.\n",
+             trace.size(), nr, trace.back().startTime);
+
+    const bool isDirect = true;
+    std::vector<std::unique_ptr<BlockDevice> > devs;
+    std::vector<std::unique_ptr<Bench> > benches;
+    opt.affinityCfg.print(nr, "id");
+    for (size_t i = 0; i < nr; i++) {
+        opt.affinityCfg.bindMemory(i);
+        devs.emplace_back(new BlockDevice(opt.getArgs()[0],
+                                          isWrite && hasWrite ? MIX_MODE : READ_MODE,
+                                          isDirect));
+        benches.emplace_back(new Bench(i, *devs[i], std::move(perThread[i]),
+                                       opt.getQueueSize(), opt.isReplayFast(), isWrite, isTrim,
+                                       opt.isShowEachResponse(), opt.getBlockSize(),
+                                       opt.asyncIoCfg));
+    }
+    opt.affinityCfg.unbindMemory();
+    std::vector<std::future<void> > workers;
+    const double bgn = getTime();
+    for (size_t i = 0; i < nr; i++) {
+        workers.push_back(std::async(std::launch::async, [&, i] {
+                    opt.affinityCfg.place(i);
+                    benches[i]->run(opt.getPeriod());
+                }));
+    }
+    worker_join(workers);
+    const double end = getTime();
+
+    std::vector<PerformanceStatistics> stats, lagStats;
+    std::vector<std::vector<PerformanceStatistics> > typeStatsV(4), recTypeStatsV(4);
+    uint64_t bytes = 0;
+    size_t nrSkipped = 0;
+    for (size_t i = 0; i < nr; i++) {
+        Bench& bench = *benches[i];
+        pop_and_show_logQ(bench.getIoLogQueue());
+        stats.push_back(bench.getStat());
+        lagStats.push_back(bench.getLagStat());
+        for (size_t j = 0; j < 4; j++) {
+            typeStatsV[j].push_back(bench.getTypeStats()[j]);
+            recTypeStatsV[j].push_back(bench.getRecordedTypeStats()[j]);
+        }
+        bytes += bench.getBytes();
+        nrSkipped += bench.getNrSkipped();
+    }
+    for (size_t i = 0; i < nr; i++) {
+        ::printf("id %zu ", i);
+        stats[i].print();
+    }
+    std::vector<PerformanceStatistics> typeStats, recTypeStats;
+    for (size_t j = 0; j < 4; j++) {
+        typeStats.push_back(mergeStats(typeStatsV[j].begin(), typeStatsV[j].end()));
+        recTypeStats.push_back(mergeStats(recTypeStatsV[j].begin(), recTypeStatsV[j].end()));
+    }
+    ::printf("---------------\n");
+    printReplayComparison(recTypeStats, typeStats);
+    if (!opt.isReplayFast()) {
+        ::printf("lag ");
+        mergeStats(lagStats.begin(), lagStats.end()).print();
+    }
+    if (nrSkipped > 0) {
+        ::printf("Skipped: %zu IOs.\n", nrSkipped);
+    }
+    PerformanceStatistics stat = mergeStats(stats.begin(), stats.end());
+    ::printf("all ");
+    stat.print();
+    printDataThroughput(bytes, stat.getCount(), end - bgn);
 }
 
 int main(int argc, char* argv[]) try
@@ -805,9 +2201,21 @@ int main(int argc, char* argv[]) try
         opt.showVersion();
     } else if (opt.isShowHelp()) {
         opt.showHelp();
+    } else if (opt.isJobFile()) {
+        execJobExperiment(opt);
+    } else if (opt.isReplay()) {
+        if (opt.getEngine() == ENGINE_URING) {
+            execReplayExperiment<IoUring>(opt);
+        } else {
+            execReplayExperiment<Aio>(opt);
+        }
     } else {
         if (opt.getNthreads() == 0) {
-            execAioExperiment(opt);
+            if (opt.getEngine() == ENGINE_URING) {
+                execAioExperiment<IoUring>(opt);
+            } else {
+                execAioExperiment<Aio>(opt);
+            }
         } else {
             execThreadExperiment(opt);
         }
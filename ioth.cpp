@@ -18,6 +18,9 @@
 #include <mutex>
 #include <memory>
 #include <chrono>
+#include <exception>
+#include <functional>
+#include <atomic>
 
 #include <cstdio>
 #include <cassert>
@@ -37,6 +40,46 @@
 #include "thread_pool.hpp"
 #include "unit_int.hpp"
 
+enum StreamLayout
+{
+    STREAM_SHARED, STREAM_PART, STREAM_STRIDE,
+};
+
+/**
+ * Sequential streams of threads.
+ * shared: the threads take IOs from one sequence.
+ * part: each thread walks its own contiguous partition of the range.
+ * stride: thread i of n takes every n-th unit from the i-th,
+ *   where a unit is the largest block size.
+ */
+struct StreamConfig
+{
+    StreamLayout layout;
+    bool isReverse; /* walk from the end to the start. */
+
+    StreamConfig() : layout(STREAM_SHARED), isReverse(false) {}
+
+    /**
+     * @s "part[,reverse]" or "stride[,reverse]".
+     */
+    void set(const std::string& s) {
+        std::vector<std::string> v = splitString(s, ',');
+        if (v.empty() || v.size() > 2 || (v.size() == 2 && v[1] != "reverse")) {
+            throw std::runtime_error("specify streams as part[,reverse] or stride[,reverse].");
+        }
+        if (v[0] == "part") {
+            layout = STREAM_PART;
+        } else if (v[0] == "stride") {
+            layout = STREAM_STRIDE;
+        } else {
+            throw std::runtime_error(formatString("bad streams: %s", v[0].c_str()));
+        }
+        isReverse = v.size() == 2;
+    }
+
+    bool isEnabled() const { return layout != STREAM_SHARED; }
+};
+
 /**
  * Parse commane-line arguments as options.
  */
@@ -56,8 +99,24 @@ private:
     size_t count_;
     size_t nthreads_;
     size_t queueSize_;
+    std::string engineName_;
+    IoEngine engine_;
+    int rwFlags_;
+    size_t batchSize_;
+    bool isAioPerThread_;
+    size_t chunkSize_;
+    bool isChunkSizeSet_;
 
 public:
+    AsyncIoConfig asyncIoCfg;
+    VectorConfig vectorCfg;
+    BsSplitConfig bsSplit;
+    RateConfig iopsCfg;
+    RateConfig bpsCfg;
+    PlacementConfig placementCfg;
+    StreamConfig streamCfg;
+    AffinityConfig affinityCfg;
+
     Options(int argc, char* argv[])
         : startBlockId_(0)
         , blockSize_(0)
@@ -69,7 +128,22 @@ public:
         , period_(0)
         , count_(0)
         , nthreads_(1)
-        , queueSize_(1) {
+        , queueSize_(1)
+        , engineName_()
+        , engine_(ENGINE_SYNC)
+        , rwFlags_(0)
+        , batchSize_(1)
+        , isAioPerThread_(false)
+        , chunkSize_(64)
+        , isChunkSizeSet_(false)
+        , asyncIoCfg()
+        , vectorCfg()
+        , bsSplit()
+        , iopsCfg()
+        , bpsCfg()
+        , placementCfg()
+        , streamCfg()
+        , affinityCfg() {
 
         parse(argc, argv);
 
@@ -86,17 +160,71 @@ public:
 
     void showHelp() {
 
-        ::printf("usage: %s [option(s)] [file or device]\n"
+        ::printf("usage: %s [option(s)] [file or device]...\n"
                  "options: \n"
                  "    -s off:  start offset in blocks.\n"
-                 "    -b size: blocksize in bytes.\n"
+                 "    -b size: blocksize in bytes, or a mix of sizes as\n"
+                 "             size:weight,size:weight,... (e.g. 4k:60,16k:30,128k:10).\n"
+                 "             each IO chooses a size by the weights and starts where\n"
+                 "             the previous one ends. the sizes must be multiples of\n"
+                 "             the smallest one, which is the unit of -s.\n"
+                 "             stats are reported for each size.\n"
                  "    -p secs: execute period in seconds.\n"
                  "    -c num:  number of IOs to execute.\n"
                  "             -p and -c is exclusive.\n"
                  "    -w:      write instead read.\n"
+                 "    -V split: issue each IO as iovecs on separately allocated buffers.\n"
+                 "             split is num for num equal iovecs, rand,num for num iovecs\n"
+                 "             of random sizes for each IO, or size,size,... for the sizes.\n"
                  "    -t num:  number of threads in parallel.\n"
                  "             if 0, use aio instead thread.\n"
-                 "    -q size: queue size.\n"
+                 "    -q size: queue size. for threads, this is the queue of -C 0.\n"
+                 "    -C num:  threads claim num blocks at once from a shared cursor\n"
+                 "             and issue IOs on them by themselves.\n"
+                 "             default: 64 or the largest block size if larger.\n"
+                 "             0 means a producer thread passes each IO to the threads\n"
+                 "             through a queue. time of threads outside IOs is reported\n"
+                 "             to compare the overhead of dispatch.\n"
+                 "    -a:      each of the threads uses aio with queue size -q\n"
+                 "             on its own partition of the access range.\n"
+                 "    -S kind[,reverse]: each of the threads issues its own sequential\n"
+                 "             stream instead of taking IOs from one shared sequence.\n"
+                 "             kind is part for a contiguous partition of the range,\n"
+                 "             or stride for every n-th unit of the largest block size\n"
+                 "             among n threads. reverse walks from the end to the start.\n"
+                 "             -c is divided among the threads, and a stream stops at\n"
+                 "             its end. throughput is reported for each stream.\n"
+                 "    -L place: placement of IOs on multiple targets.\n"
+                 "             stripe[,chunk] (default) places chunks on the targets in turn,\n"
+                 "             hash[,chunk] places them by a hash of the offset,\n"
+                 "             and thread makes thread i use target i %% the targets.\n"
+                 "             -s is for all the targets, and IOs skip to the next chunk\n"
+                 "             instead of crossing chunks. the chunk size must be\n"
+                 "             a multiple of -b. default: 64KiB or more.\n"
+                 "             stats are reported for each target.\n"
+                 "    -R iops[,thread]: cap IOs per second shared by the threads,\n"
+                 "             or of each thread with ',thread'.\n"
+                 "    -B bytes[,thread]: cap bytes per second in the same way.\n"
+                 "             each IO waits for a token bucket, which saves up to\n"
+                 "             1ms of tokens while idle.\n"
+                 "    -e name: IO engine, 'sync', 'pvsync2', 'aio', or 'uring'.\n"
+                 "             sync and pvsync2 are for threads, and the default is sync.\n"
+                 "             aio and uring are for -t 0 or -a, and the default is aio.\n"
+                 "    -F flags: RWF flags for -e pvsync2 as a comma-separated list of\n"
+                 "             hipri, nowait, dsync, and append.\n"
+                 "    -Q idle[,cpu]: submit IOs by a kernel polling thread (SQPOLL)\n"
+                 "             which sleeps after idle [ms] and runs on cpu.\n"
+                 "             this is meaningfull with -e uring.\n"
+                 "    -u:      reap aio completions in user space when available.\n"
+                 "             this is meaningfull with -e aio.\n"
+                 "    -k num:  reap up to num IOs at once and resubmit them together.\n"
+                 "             default: 1. this is meaningfull with -t 0 or -a.\n"
+                 "    -A cpus: pin thread i to cpu i %% the cpus, where cpus is a list\n"
+                 "             like 0-3,8, compact to fill a NUMA node before the next,\n"
+                 "             or scatter to take the nodes in turn. the worker of -t 0\n"
+                 "             is thread 0. the placement is reported before the run.\n"
+                 "    -N:      bind buffers and aio structures of each thread\n"
+                 "             to the NUMA node of its cpu. this requires -A.\n"
                  "    -r:      show response of each IO.\n"
                  "    -v:      show version.\n"
                  "    -h:      show this help.\n"
@@ -115,6 +243,14 @@ public:
     size_t getCount() const { return count_; }
     size_t getNthreads() const { return nthreads_; }
     size_t getQueueSize() const { return queueSize_; }
+    IoEngine getEngine() const { return engine_; }
+    int getRwFlags() const { return rwFlags_; }
+    size_t getBatchSize() const { return batchSize_; }
+    bool isAioPerThread() const { return isAioPerThread_; }
+    size_t getChunkSize() const { return chunkSize_; }
+    Throttle getThrottle() const {
+        return Throttle(iopsCfg, bpsCfg, nthreads_, bsSplit.getMax());
+    }
 
 private:
     void parse(int argc, char* argv[]) {
@@ -122,7 +258,7 @@ private:
         programName_ = argv[0];
 
         while (1) {
-            int c = ::getopt(argc, argv, "s:b:p:c:t:q:wrvh");
+            int c = ::getopt(argc, argv, "s:b:p:c:t:q:aC:S:L:R:B:e:F:Q:uk:A:NV:wrvh");
 
             if (c < 0) { break; }
 
@@ -130,8 +266,9 @@ private:
             case 's': /* start offset in blocks */
                 startBlockId_ = fromUnitIntString(optarg);
                 break;
-            case 'b': /* blocksize */
-                blockSize_ = fromUnitIntString(optarg);
+            case 'b': /* blocksize or bssplit */
+                bsSplit.set(optarg);
+                blockSize_ = bsSplit.getMin();
                 break;
             case 'p': /* period */
                 period_ = ::atol(optarg);
@@ -142,12 +279,55 @@ private:
             case 'w': /* write */
                 mode_ = WRITE_MODE;
                 break;
+            case 'V': /* vectored IO */
+                vectorCfg.set(optarg);
+                break;
             case 't': /* nthreads */
                 nthreads_ = ::atol(optarg);
                 break;
             case 'q': /* queueSize */
                 queueSize_ = ::atol(optarg);
                 break;
+            case 'a': /* aio per thread */
+                isAioPerThread_ = true;
+                break;
+            case 'C': /* chunk size */
+                chunkSize_ = fromUnitIntString(optarg);
+                isChunkSizeSet_ = true;
+                break;
+            case 'S': /* streams */
+                streamCfg.set(optarg);
+                break;
+            case 'L': /* placement on targets */
+                placementCfg.set(optarg);
+                break;
+            case 'R': /* IOPS cap */
+                iopsCfg.set(optarg);
+                break;
+            case 'B': /* bandwidth cap */
+                bpsCfg.set(optarg);
+                break;
+            case 'e': /* IO engine */
+                engineName_ = optarg;
+                break;
+            case 'F': /* RWF flags */
+                rwFlags_ = parseRwFlags(optarg);
+                break;
+            case 'Q': /* SQPOLL */
+                asyncIoCfg.setSqpoll(optarg);
+                break;
+            case 'u': /* user space reaping */
+                asyncIoCfg.isUserReap = true;
+                break;
+            case 'k': /* batch size */
+                batchSize_ = ::atol(optarg);
+                break;
+            case 'A': /* cpu affinity */
+                affinityCfg.set(optarg);
+                break;
+            case 'N': /* NUMA memory binding */
+                affinityCfg.isNumaBind = true;
+                break;
             case 'r': /* show each response */
                 isShowEachResponse_ = true;
                 break;
@@ -167,7 +347,7 @@ private:
 
     void checkAndThrow() {
 
-        if (args_.size() != 1 || blockSize_ == 0) {
+        if (args_.empty() || blockSize_ == 0) {
             throw std::runtime_error("specify blocksize (-b), and device.");
         }
         if (period_ == 0 && count_ == 0) {
@@ -176,6 +356,52 @@ private:
         if (queueSize_ == 0) {
             throw std::runtime_error("queue size (-q) must be 1 or more.");
         }
+        if (batchSize_ == 0 || batchSize_ > queueSize_) {
+            throw std::runtime_error("batch size (-k) must be between 1 and queue size (-q).");
+        }
+        if (affinityCfg.isNumaBind && !affinityCfg.isEnabled()) {
+            throw std::runtime_error("NUMA binding (-N) requires cpu affinity (-A).");
+        }
+        vectorCfg.setBlockSize(blockSize_);
+        if (vectorCfg.isEnabled() && bsSplit.isSplit()) {
+            throw std::runtime_error("vectored IO (-V) does not work with a mix of block sizes.");
+        }
+        const bool isAio = nthreads_ == 0 || isAioPerThread_;
+        if (engineName_.empty()) {
+            engine_ = isAio ? ENGINE_LIBAIO : ENGINE_SYNC;
+        } else {
+            engine_ = parseIoEngine(engineName_);
+        }
+        if (isAsyncEngine(engine_) != isAio) {
+            throw std::runtime_error("engine (-e) does not match -t and -a.");
+        }
+        if (engine_ == ENGINE_MMAP) {
+            throw std::runtime_error("ioth does not support -e mmap.");
+        }
+        if (rwFlags_ != 0 && engine_ != ENGINE_PVSYNC2) {
+            throw std::runtime_error("RWF flags (-F) require -e pvsync2.");
+        }
+        if (asyncIoCfg.isSqpoll() && engine_ != ENGINE_URING) {
+            throw std::runtime_error("SQPOLL (-Q) requires -e uring.");
+        }
+        if (asyncIoCfg.isUserReap && engine_ != ENGINE_LIBAIO) {
+            throw std::runtime_error("user space reaping (-u) requires -e aio.");
+        }
+        const size_t maxBlocks = bsSplit.getMax() / blockSize_;
+        if (!isChunkSizeSet_) {
+            chunkSize_ = std::max<size_t>(chunkSize_, maxBlocks);
+        } else if (!isAio && !streamCfg.isEnabled() && chunkSize_ > 0 && chunkSize_ < maxBlocks) {
+            throw std::runtime_error("chunk size (-C) must be 0 or at least the largest block size.");
+        }
+        if (streamCfg.isEnabled() && isAio) {
+            throw std::runtime_error("streams (-S) are for threads. -a gives each its own partition.");
+        }
+        if (args_.size() > 1) {
+            if (placementCfg.type == PLACE_THREAD && nthreads_ == 0) {
+                throw std::runtime_error("thread placement (-L thread) requires threads (-t).");
+            }
+            placementCfg.setChunkSize(bsSplit);
+        }
     }
 };
 
@@ -187,62 +413,102 @@ class IoThroughputBench
 {
 private:
 
-    const std::string name_;
     const Mode mode_;
-    const size_t blockSize_; /* [byte] */
+    const BsSplitConfig bsSplit_;
+    const size_t blockSize_; /* [byte]. the smallest IO size. */
     const unsigned int nThreads_;
     const unsigned queueSize_;
     const bool isShowEachResponse_;
+    const AffinityConfig affinityCfg_;
     size_t maxBlockId_;
+    Xoshiro256 rand_; /* used by the submitter to choose IO sizes. */
+
+    typedef std::pair<size_t, size_t> Task; /* block id and IO size [byte]. */
 
     class ThreadLocalData
     {
     private:
         char *buf_;
-        BlockDevice bd_;
+        TargetSet targets_;
         std::queue<IoLog> logQ_;
         size_t blockSize_;
         PerformanceStatistics stat_;
+        std::vector<PerformanceStatistics> sizeStats_;
+        TargetStatistics targetStats_;
+        std::unique_ptr<IovecBuffer> iovBuf_;
+        Throttle throttle_;
+        uint64_t bytes_;
+        double period_; /* [sec] of the stream. */
 
     public:
-        ThreadLocalData(BlockDevice&& bd, size_t blockSize)
-            : bd_(std::move(bd))
-            , blockSize_(blockSize) {
-
+        /**
+         * @nrTargets number of all the targets to record statistics of each.
+         *   1 means not to record.
+         */
+        ThreadLocalData(TargetSet&& targets, size_t nrTargets, const BsSplitConfig& bsSplit,
+                        const VectorConfig& vectorCfg, const Throttle& throttle)
+            : targets_(std::move(targets))
+            , blockSize_(bsSplit.getMin())
+            , sizeStats_(bsSplit.getNr())
+            , targetStats_(nrTargets > 1 ? nrTargets : 0)
+            , iovBuf_(new IovecBuffer(1, blockSize_, vectorCfg, Xoshiro256(std::random_device()())))
+            , throttle_(throttle)
+            , bytes_(0)
+            , period_(0) {
+
+            const size_t bufSize = bsSplit.getMax();
             size_t alignSize = 512;
-            while (alignSize < blockSize) {
+            while (alignSize < bufSize) {
                 alignSize *= 2;
             }
-            if(::posix_memalign((void **)&buf_, alignSize, blockSize) != 0) {
+            if(::posix_memalign((void **)&buf_, alignSize, bufSize) != 0) {
                 throw std::runtime_error("posix_memalign failed");
             }
         }
         explicit ThreadLocalData(ThreadLocalData&& rhs)
             : buf_(rhs.buf_)
-            , bd_(std::move(rhs.bd_))
+            , targets_(std::move(rhs.targets_))
             , logQ_(std::move(rhs.logQ_))
             , blockSize_(rhs.blockSize_)
-            , stat_(rhs.stat_) {
+            , stat_(rhs.stat_)
+            , sizeStats_(std::move(rhs.sizeStats_))
+            , targetStats_(std::move(rhs.targetStats_))
+            , iovBuf_(std::move(rhs.iovBuf_))
+            , throttle_(rhs.throttle_)
+            , bytes_(rhs.bytes_)
+            , period_(rhs.period_) {
 
             rhs.buf_ = nullptr;
         }
         ThreadLocalData& operator=(ThreadLocalData&& rhs) {
 
             buf_ = rhs.buf_; rhs.buf_ = nullptr;
-            bd_ = std::move(rhs.bd_);
+            targets_ = std::move(rhs.targets_);
             logQ_ = std::move(rhs.logQ_);
             blockSize_ = rhs.blockSize_;
             stat_ = rhs.stat_;
+            sizeStats_ = std::move(rhs.sizeStats_);
+            targetStats_ = std::move(rhs.targetStats_);
+            iovBuf_ = std::move(rhs.iovBuf_);
+            throttle_ = rhs.throttle_;
+            bytes_ = rhs.bytes_;
+            period_ = rhs.period_;
             return *this;
         }
 
         ~ThreadLocalData() noexcept { free(buf_); }
 
-        BlockDevice& getBlockDevice() { return bd_; }
-        size_t getBlockDeviceSize() const { return bd_.getDeviceSize() / blockSize_; }
+        TargetSet& getTargets() { return targets_; }
+        size_t getBlockDeviceSize() const { return targets_.getDeviceSize() / blockSize_; }
         char* getBuffer() { return buf_; }
+        IovecBuffer& getIovecBuffer() { return *iovBuf_; }
         std::queue<IoLog>& getLogQueue() { return logQ_; }
         PerformanceStatistics& getPerformanceStatistics() { return stat_; }
+        std::vector<PerformanceStatistics>& getSizeStats() { return sizeStats_; }
+        TargetStatistics& getTargetStats() { return targetStats_; }
+        Throttle& getThrottle() { return throttle_; }
+        uint64_t& getBytes() { return bytes_; }
+        double& getPeriod() { return period_; }
 
     private:
 
@@ -251,19 +517,25 @@ private:
 
 public:
     /**
-     * @param dev block device.
-     * @param bs block size.
+     * @param names block devices.
+     * @param bsSplit IO sizes.
      * @param nBlocks disk size as number of blocks.
      * @param startBlockId
      */
-    IoThroughputBench(const std::string& name, const Mode mode, size_t blockSize,
-                      unsigned int nThreads, unsigned queueSize, bool isShowEachResponse)
-        : name_(name)
-        , mode_(mode)
-        , blockSize_(blockSize)
+    IoThroughputBench(const std::vector<std::string>& names, const Mode mode,
+                      const BsSplitConfig& bsSplit,
+                      unsigned int nThreads, unsigned queueSize, bool isShowEachResponse,
+                      IoEngine engine, int rwFlags, const VectorConfig& vectorCfg,
+                      const Throttle& throttle, const PlacementConfig& placementCfg,
+                      const AffinityConfig& affinityCfg)
+        : mode_(mode)
+        , bsSplit_(bsSplit)
+        , blockSize_(bsSplit.getMin())
         , nThreads_(nThreads)
         , queueSize_(queueSize)
-        , isShowEachResponse_(isShowEachResponse) {
+        , isShowEachResponse_(isShowEachResponse)
+        , affinityCfg_(affinityCfg)
+        , rand_(std::random_device()()) {
 #if 0
         ::printf("blockSize %zu nThreads %u isShowEachResponse %d\n",
                  blockSize_, nThreads_, isShowEachResponse_);
@@ -272,12 +544,21 @@ public:
         for (unsigned int i = 0; i < nThreads; i++) {
 
             bool isDirect = true;
-            BlockDevice bd(name, mode, isDirect);
-            ThreadLocalData threadLocal(std::move(bd), blockSize);
+            TargetSet targets(names, mode, isDirect, placementCfg, i);
+            if (engine == ENGINE_PVSYNC2) {
+                targets.setPositional(rwFlags);
+            }
+            affinityCfg_.bindMemory(i);
+            ThreadLocalData threadLocal(std::move(targets), names.size(),
+                                        bsSplit, vectorCfg, throttle);
             threadLocal_.push_back(std::move(threadLocal));
         }
+        affinityCfg_.unbindMemory();
         assert(threadLocal_.size() == nThreads);
-        maxBlockId_ = threadLocal_[0].getBlockDeviceSize();
+        maxBlockId_ = SIZE_MAX;
+        for (const ThreadLocalData& tLocal : threadLocal_) {
+            maxBlockId_ = std::min(maxBlockId_, tLocal.getBlockDeviceSize());
+        }
     }
     ~IoThroughputBench() noexcept {}
 
@@ -287,16 +568,16 @@ public:
      */
     void execNtimes(size_t n, size_t startBlockId) {
 
-        ThreadPoolWithId<size_t> threadPool(
+        ThreadPoolWithId<Task> threadPool(
             nThreads_, queueSize_,
-            [&](size_t blockId, unsigned int id) {
-                this->doWork(blockId, id);
-            });
+            [&](const Task& task, unsigned int id) {
+                this->doWork(task.first, task.second, id);
+            }, 1, [&](unsigned int id) { affinityCfg_.place(id); });
 
-        size_t endBlockId = std::min(maxBlockId_, startBlockId + n);
-
-        for (size_t i = startBlockId; i < endBlockId; i++) {
-            threadPool.submit(i);
+        size_t blockId = startBlockId;
+        Task task;
+        for (size_t i = 0; i < n && nextTask(blockId, task); i++) {
+            threadPool.submit(task);
         }
         threadPool.flush(); threadPool.stop(); threadPool.join();
         threadPool.get(); //may throw an excpetion
@@ -309,23 +590,23 @@ public:
      */
     void execNsecs(size_t runPeriodInSec, size_t startBlockId) {
 
-        ThreadPoolWithId<size_t> threadPool(
+        ThreadPoolWithId<Task> threadPool(
             nThreads_, queueSize_,
-            [&](size_t blockId, unsigned int id) {
-                this->doWork(blockId, id);
-            });
+            [&](const Task& task, unsigned int id) {
+                this->doWork(task.first, task.second, id);
+            }, 1, [&](unsigned int id) { affinityCfg_.place(id); });
 
         std::atomic<bool> shouldStop(false);
         std::thread th([&] {
                 size_t blockId = startBlockId;
+                Task task;
                 while (!shouldStop.load()) {
-                    threadPool.submit(blockId);
-                    blockId++;
-                    if (blockId >= maxBlockId_) {
+                    if (!nextTask(blockId, task)) {
                         threadPool.flush();
                         threadPool.stop();
                         break;
                     }
+                    threadPool.submit(task);
                 }
             });
         threadPool.waitFor(std::chrono::seconds(runPeriodInSec));
@@ -336,6 +617,91 @@ public:
                           //if errors have been occurred.
     }
 
+    /**
+     * Each thread issues IOs of its own stream.
+     * @n Number of IOs in total. 0 means to run runPeriodInSec.
+     * @runPeriodInSec Run period [second].
+     * @startBlockId Start block id [block].
+     */
+    void execStreams(const StreamConfig& cfg, size_t n, size_t runPeriodInSec,
+                     size_t startBlockId) {
+
+        if (maxBlockId_ < startBlockId + nThreads_ * bsSplit_.getMax() / blockSize_) {
+            throw std::runtime_error("access range is too small for the streams.");
+        }
+        const uint64_t seed = rand_.get();
+        runWorkers([&](unsigned int i) {
+                Stream stream(cfg, startBlockId, maxBlockId_, i, nThreads_,
+                              blockSize_, bsSplit_.getMax() / blockSize_);
+                Xoshiro256 rand(Xoshiro256::stream(seed, i));
+                const size_t count = n * (i + 1) / nThreads_ - n * i / nThreads_;
+                const TargetSet& targets = threadLocal_[i].getTargets();
+                const double begin = getTime();
+                double now = begin;
+                size_t c = 0;
+                size_t blockId;
+                while (n > 0 ? c < count
+                       : now - begin < static_cast<double>(runPeriodInSec)) {
+                    const size_t size = bsSplit_.pick(rand);
+                    if (!stream.next(size, targets, blockId)) break;
+                    doWork(blockId, size, i);
+                    now = getTime();
+                    c++;
+                }
+                threadLocal_[i].getPeriod() = getTime() - begin;
+            });
+    }
+
+    /**
+     * Threads claim chunkSize blocks at once from a shared cursor and issue
+     * IOs on them by themselves, instead of a producer thread passing
+     * each IO through the queue of a thread pool.
+     * The IO at the end of a chunk is the smallest size if the chosen one does not fit.
+     * @n Number of IOs in total. 0 means to run runPeriodInSec.
+     * @runPeriodInSec Run period [second].
+     * @startBlockId Start block id [block].
+     * @chunkSize [block]
+     */
+    void execChunks(size_t n, size_t runPeriodInSec, size_t startBlockId, size_t chunkSize) {
+
+        std::atomic<size_t> cursor(startBlockId);
+        std::atomic<size_t> nrIos(0);
+        const uint64_t seed = rand_.get();
+        runWorkers([&](unsigned int i) {
+                Xoshiro256 rand(Xoshiro256::stream(seed, i));
+                const TargetSet& targets = threadLocal_[i].getTargets();
+                const double begin = getTime();
+                double now = begin;
+                bool isEnd = false;
+                while (!isEnd) {
+                    size_t blockId = cursor.fetch_add(chunkSize, std::memory_order_relaxed);
+                    if (blockId >= maxBlockId_) break;
+                    const size_t endId = std::min(blockId + chunkSize, maxBlockId_);
+                    for (;;) {
+                        size_t size = bsSplit_.pick(rand);
+                        size_t id = targets.fit(blockId * blockSize_, size) / blockSize_;
+                        if (id + size / blockSize_ > endId) {
+                            size = bsSplit_.getMin();
+                            id = blockId;
+                            if (id + 1 > endId) break;
+                        }
+                        if (n > 0 && nrIos.fetch_add(1, std::memory_order_relaxed) >= n) {
+                            isEnd = true;
+                            break;
+                        }
+                        doWork(id, size, i);
+                        blockId = id + size / blockSize_;
+                        now = getTime();
+                        if (n == 0 && now - begin >= static_cast<double>(runPeriodInSec)) {
+                            isEnd = true;
+                            break;
+                        }
+                    }
+                }
+                threadLocal_[i].getPeriod() = getTime() - begin;
+            });
+    }
+
     PerformanceStatistics getStat(unsigned int id) {
 
         return threadLocal_[id].getPerformanceStatistics();
@@ -347,6 +713,34 @@ public:
         return mergeStats(li.begin(), li.end());
     }
 
+    /**
+     * Get statistics of each IO size merged among the threads.
+     */
+    std::vector<PerformanceStatistics> getMergedSizeStats() {
+
+        std::vector<PerformanceStatistics> ret;
+        for (size_t i = 0; i < bsSplit_.getNr(); i++) {
+            std::vector<PerformanceStatistics> v;
+            for (ThreadLocalData& tLocal : threadLocal_) {
+                v.push_back(tLocal.getSizeStats()[i]);
+            }
+            ret.push_back(mergeStats(v.begin(), v.end()));
+        }
+        return ret;
+    }
+
+    /**
+     * Get statistics of each target merged among the threads.
+     */
+    TargetStatistics getMergedTargetStats() {
+
+        TargetStatistics ret;
+        for (ThreadLocalData& tLocal : threadLocal_) {
+            ret.merge(tLocal.getTargetStats());
+        }
+        return ret;
+    }
+
     /**
      * Get the log queue of the thread with 'id'.
      */
@@ -355,41 +749,192 @@ public:
         return threadLocal_[id].getLogQueue();
     }
 
+    /**
+     * Get bytes and period of the thread with 'id'.
+     * The period is set by execStreams() and execChunks().
+     */
+    uint64_t getBytes(unsigned int id) { return threadLocal_[id].getBytes(); }
+    double getPeriod(unsigned int id) { return threadLocal_[id].getPeriod(); }
+
+    /**
+     * Get number of IOs returned EAGAIN in the thread with 'id'.
+     */
+    size_t getNrAgain(unsigned int id) {
+
+        return threadLocal_[id].getTargets().getNrAgain();
+    }
+
 private:
+    /**
+     * Run f(id) on each thread of its own and wait for all of them.
+     */
+    void runWorkers(const std::function<void(unsigned int)>& f) {
+
+        std::vector<std::future<void> > workers;
+        for (unsigned int i = 0; i < nThreads_; i++) {
+            workers.push_back(std::async(std::launch::async, [&, i] {
+                        affinityCfg_.place(i);
+                        f(i);
+                    }));
+        }
+        /* get all to wait for all before an exception goes out. */
+        std::exception_ptr ep;
+        for (std::future<void>& f : workers) {
+            try {
+                f.get();
+            } catch (...) {
+                ep = std::current_exception();
+            }
+        }
+        if (ep) std::rethrow_exception(ep);
+    }
+
+    /**
+     * Positions of the IOs of a stream.
+     */
+    class Stream
+    {
+    private:
+        const bool isReverse_;
+        const size_t blockSize_; /* [byte] */
+        const bool isStride_;
+        size_t bgn_; /* [block]. the partition, or the first unit of stride. */
+        size_t end_; /* [block] */
+        size_t pos_; /* the next IO starts at (or ends at with reverse) [block]. */
+        size_t step_; /* [block] between units of the stride. */
+        size_t nrUnits_; /* of the stride. */
+        size_t done_; /* units of the stride already issued. */
+
+    public:
+        /**
+         * @bgn @end the range of all the streams [block].
+         * @idx @nr index of the stream and the number of streams.
+         * @unit the unit of stride [block].
+         */
+        Stream(const StreamConfig& cfg, size_t bgn, size_t end, size_t idx, size_t nr,
+               size_t blockSize, size_t unit)
+            : isReverse_(cfg.isReverse), blockSize_(blockSize)
+            , isStride_(cfg.layout == STREAM_STRIDE)
+            , bgn_(0), end_(0), pos_(0), step_(unit * nr)
+            , nrUnits_(0), done_(0) {
+
+            if (isStride_) {
+                /* units are aligned to their size to fit in chunks of targets. */
+                const size_t base = (bgn + unit - 1) / unit * unit;
+                const size_t total = end / unit - base / unit;
+                bgn_ = base + idx * unit;
+                nrUnits_ = total > idx ? (total - 1 - idx) / nr + 1 : 0;
+            } else {
+                const size_t len = end - bgn;
+                bgn_ = bgn + len * idx / nr;
+                end_ = bgn + len * (idx + 1) / nr;
+                pos_ = isReverse_ ? end_ : bgn_;
+            }
+        }
+
+        /**
+         * @size IO size [byte].
+         * @targets IOs are moved not to cross chunks of them.
+         * @blockId the IO will be set.
+         * @return false at the end of the stream.
+         */
+        bool next(size_t size, const TargetSet& targets, size_t& blockId) {
+
+            const size_t nrBlocks = size / blockSize_;
+            if (isStride_) {
+                /* an IO at the start of each unit. */
+                if (done_ == nrUnits_) return false;
+                const size_t i = isReverse_ ? nrUnits_ - 1 - done_ : done_;
+                blockId = bgn_ + i * step_;
+                done_++;
+                return true;
+            }
+            if (isReverse_) {
+                if (pos_ < bgn_ + nrBlocks) return false;
+                size_t oft = (pos_ - nrBlocks) * blockSize_;
+                const size_t fitted = targets.fit(oft, size);
+                if (fitted != oft) oft = fitted - size;
+                if (oft < bgn_ * blockSize_) return false;
+                blockId = oft / blockSize_;
+                pos_ = blockId;
+                return true;
+            }
+            blockId = targets.fit(pos_ * blockSize_, size) / blockSize_;
+            if (blockId + nrBlocks > end_) return false;
+            pos_ = blockId + nrBlocks;
+            return true;
+        }
+    };
+
+    /**
+     * Choose the size of the IO at blockId and advance blockId past it.
+     * @task the IO will be set.
+     * @return false if the IO does not fit in the device.
+     */
+    bool nextTask(size_t& blockId, Task& task) {
+
+        const size_t size = bsSplit_.pick(rand_);
+        const size_t nrBlocks = size / blockSize_;
+        blockId = threadLocal_[0].getTargets().fit(blockId * blockSize_, size) / blockSize_;
+        if (blockId + nrBlocks > maxBlockId_) { return false; }
+        task = Task(blockId, size);
+        blockId += nrBlocks;
+        return true;
+    }
+
     /**
      * Execute an IO.
      *
      * @blockId block id [block]
+     * @size IO size [byte]
      * @id Thread id (starting from 0).
      */
-    void doWork(size_t blockId, unsigned int id) {
+    void doWork(size_t blockId, size_t size, unsigned int id) {
 
         bool isWrite = (mode_ == WRITE_MODE);
 
         auto& tLocal = threadLocal_[id];
-        auto& bd = tLocal.getBlockDevice();
+        auto& targets = tLocal.getTargets();
         char* buf = tLocal.getBuffer();
+        auto& iovBuf = tLocal.getIovecBuffer();
         auto& stat = tLocal.getPerformanceStatistics();
 
-        IoLog log = execBlockIO(bd, id, isWrite, blockId, buf);
+        tLocal.getThrottle().acquire(size);
+        IoLog log = execBlockIO(targets, id, isWrite, blockId, size, buf, iovBuf);
 
         if (isShowEachResponse_) { tLocal.getLogQueue().push(log); }
         stat.updateRt(log.response);
+        if (bsSplit_.isSplit()) {
+            tLocal.getSizeStats()[bsSplit_.getIndex(size)].updateRt(log.response);
+        }
+        if (tLocal.getTargetStats().isEnabled()) {
+            tLocal.getTargetStats().add(targets.getLastId(), size, log.response);
+        }
+        tLocal.getBytes() += size;
     }
 
     /**
      * @return IO log.
      */
-    IoLog execBlockIO(BlockDevice& bd, unsigned int threadId, bool isWrite, size_t blockId, char* buf) {
+    IoLog execBlockIO(TargetSet& targets, unsigned int threadId, bool isWrite, size_t blockId,
+                      size_t size, char* buf, IovecBuffer& iovBuf) {
 
         double begin, end;
         size_t oft = blockId * blockSize_;
+        const int nrSegs = iovBuf.getNrSegs();
+        struct iovec *iov = nrSegs > 0 ? iovBuf.next() : nullptr;
         begin = getTime();
 
-        if (isWrite) {
-            bd.write(oft, blockSize_, buf);
+        if (iov) {
+            if (isWrite) {
+                targets.writev(oft, iov, nrSegs);
+            } else {
+                targets.readv(oft, iov, nrSegs);
+            }
+        } else if (isWrite) {
+            targets.write(oft, size, buf);
         } else {
-            bd.read(oft, blockSize_, buf);
+            targets.read(oft, size, buf);
         }
         end = getTime();
 
@@ -415,14 +960,23 @@ private:
  */
 void execThreadExperiment(const Options& opt)
 {
+    opt.affinityCfg.print(opt.getNthreads(), "threadId");
     IoThroughputBench bench(
-        opt.getArgs()[0], opt.getMode(), opt.getBlockSize(),
-        opt.getNthreads(), opt.getQueueSize(), opt.isShowEachResponse());
+        opt.getArgs(), opt.getMode(), opt.bsSplit,
+        opt.getNthreads(), opt.getQueueSize(), opt.isShowEachResponse(),
+        opt.getEngine(), opt.getRwFlags(), opt.vectorCfg, opt.getThrottle(),
+        opt.placementCfg, opt.affinityCfg);
 
     double begin, end;
     begin = getTime();
     try {
-        if (opt.getPeriod() > 0) {
+        if (opt.streamCfg.isEnabled()) {
+            bench.execStreams(opt.streamCfg, opt.getCount(), opt.getPeriod(),
+                              opt.getStartBlockId());
+        } else if (opt.getChunkSize() > 0) {
+            bench.execChunks(opt.getCount(), opt.getPeriod(), opt.getStartBlockId(),
+                             opt.getChunkSize());
+        } else if (opt.getPeriod() > 0) {
             bench.execNsecs(opt.getPeriod(), opt.getStartBlockId());
         } else {
             bench.execNtimes(opt.getCount(), opt.getStartBlockId());
@@ -445,92 +999,152 @@ void execThreadExperiment(const Options& opt)
     }
 
     /* Print statistics. */
+    const bool isSelf = opt.streamCfg.isEnabled() || opt.getChunkSize() > 0;
+    double outside = 0; /* time of the threads outside IOs [sec]. */
     for (unsigned int id = 0; id < opt.getNthreads(); id++) {
 
+        outside += (isSelf ? bench.getPeriod(id) : end - begin) - bench.getStat(id).getTotal();
         ::printf("threadId %u ", id);
         bench.getStat(id).print();
+        if (opt.streamCfg.isEnabled()) {
+            ::printf("threadId %u ", id);
+            printDataThroughput(bench.getBytes(id), bench.getStat(id).getCount(),
+                                bench.getPeriod(id));
+        }
+        if (opt.getRwFlags() & RWF_NOWAIT) {
+            ::printf("threadId %u EAGAIN %zu\n", id, bench.getNrAgain(id));
+        }
     }
     auto stat = bench.getMergedStat();
-    ::printf("----------------\n"
-             "all ");
+    ::printf("----------------\n");
+    uint64_t bytes = opt.getBlockSize() * stat.getCount();
+    if (opt.bsSplit.isSplit()) {
+        bytes = printSizeStats(opt.bsSplit, bench.getMergedSizeStats(), end - begin);
+    }
+    ::printf("all ");
     stat.print();
-    printThroughput(opt.getBlockSize(), stat.getCount(), end - begin);
+    printDataThroughput(bytes, stat.getCount(), end - begin);
+    ::printf("Dispatch: %.3f us/IO of threads outside IOs.\n",
+             stat.getCount() == 0 ? 0.0 : outside * 1000000.0 / stat.getCount());
+    if (opt.getArgs().size() > 1) {
+        bench.getMergedTargetStats().print(opt.getArgs(), end - begin);
+    }
 }
 
 /**
  * Asynchronous IO throughptu benchmark.
  * This is single-thread.
+ * AsyncIo is Aio or IoUring.
  */
+template <typename AsyncIo>
 class AioThroughputBench
 {
 private:
 
-    const std::string name_;
     const Mode mode_;
-    const size_t blockSize_; /* [byte] */
+    const BsSplitConfig bsSplit_;
+    const size_t blockSize_; /* [byte]. the smallest IO size. */
     const unsigned int queueSize_;
     const bool isShowEachResponse_;
+    const size_t batchSize_;
+    const unsigned int threadId_;
 
     std::queue<IoLog> logQ_;
     PerformanceStatistics stat_;
-    BlockDevice bd_;
-    Aio aio_;
+    std::vector<PerformanceStatistics> sizeStats_; /* indexed as bsSplit_.sizes. */
+    TargetStatistics targetStats_;
+    Xoshiro256 rand_;
+    size_t nextSize_; /* size of the next IO [byte]. */
+    TargetSet targets_;
+    AsyncIo aio_;
     const size_t maxBlockId_;
     BlockBuffer bb_;
+    IovecBuffer iovBuf_;
+    std::vector<AioData *> doneV_; /* temporal use for waitIos(). */
+    BatchStatistics reapStat_;
+    BatchStatistics submitStat_;
+    Throttle throttle_;
 
 public:
     /**
-     * @param dev block device.
-     * @param bs block size.
+     * @param names block devices.
+     * @param bsSplit IO sizes.
      * @param nBlocks disk size as number of blocks.
      * @param startBlockId
      */
     AioThroughputBench(
-        const std::string& name, const Mode mode, size_t blockSize,
-        unsigned int queueSize, bool isShowEachResponse)
-        : name_(name)
-        , mode_(mode)
-        , blockSize_(blockSize)
+        const std::vector<std::string>& names, const Mode mode, const BsSplitConfig& bsSplit,
+        unsigned int queueSize, bool isShowEachResponse,
+        const AsyncIoConfig& asyncIoCfg, size_t batchSize,
+        const VectorConfig& vectorCfg, const Throttle& throttle,
+        const PlacementConfig& placementCfg, unsigned int threadId = 0)
+        : mode_(mode)
+        , bsSplit_(bsSplit)
+        , blockSize_(bsSplit.getMin())
         , queueSize_(queueSize)
         , isShowEachResponse_(isShowEachResponse)
-        , bd_(name, mode, true)
-        , aio_(bd_.getFd(), queueSize)
-        , maxBlockId_(bd_.getDeviceSize() / blockSize)
-        , bb_(queueSize_ * 2, blockSize_) {
+        , batchSize_(batchSize)
+        , threadId_(threadId)
+        , logQ_()
+        , stat_()
+        , sizeStats_(bsSplit.getNr())
+        , targetStats_(names.size() > 1 ? names.size() : 0)
+        , rand_(std::random_device()())
+        , nextSize_(bsSplit.pick(rand_))
+        , targets_(names, mode, true, placementCfg, threadId)
+        , aio_(targets_.getFds(), queueSize, asyncIoCfg)
+        , maxBlockId_(targets_.getDeviceSize() / blockSize_)
+        , bb_(queueSize_ * 2, bsSplit.getMax())
+        , iovBuf_(queueSize_ * 2, blockSize_, vectorCfg, Xoshiro256(std::random_device()()))
+        , doneV_()
+        , reapStat_(batchSize)
+        , submitStat_(queueSize)
+        , throttle_(throttle) {
 #if 0
         ::printf("blockSize %zu queueSize %u isShowEachResponse %d\n",
                  blockSize_, queueSize_, isShowEachResponse_);
 #endif
         assert(queueSize > 0);
+        assert(0 < batchSize_ && batchSize_ <= queueSize_);
+        aio_.registerBuffers(bb_.getIovecs());
     }
 
     /**
-     * @n Number of blocks to issue.
+     * @n Number of IOs to issue.
      * @startBlockId Start block id [block].
+     * @endBlockId IOs will not be issued at or after the block [block].
      */
-    void execNtimes(size_t n, size_t startBlockId) {
+    void execNtimes(size_t n, size_t startBlockId, size_t endBlockId = SIZE_MAX) {
 
         size_t pending = 0;
+        size_t c = 0;
         size_t blockId = startBlockId;
-        size_t endBlockId = std::min(maxBlockId_, startBlockId + n);
+        const size_t maxBlockId = std::min(maxBlockId_, endBlockId);
 
         /* Fill the queue. */
-        while (pending < queueSize_ && blockId < endBlockId) {
-            prepareIo(blockId++, bb_.next());
+        while (pending < queueSize_ && c < n && canIssue(blockId, maxBlockId)) {
+            prepareIo(blockId, bb_.next());
             pending++;
+            c++;
         }
-        aio_.submit();
+        submit(pending);
         /* Wait and fill. */
-        while (blockId < endBlockId) {
+        while (c < n && canIssue(blockId, maxBlockId)) {
 
             assert(pending == queueSize_);
 
-            waitAnIo();
-            pending--;
+            double endTime;
+            const size_t nr = waitIos(endTime);
+            pending -= nr;
 
-            prepareIo(blockId++, bb_.next());
-            pending++;
-            aio_.submit();
+            size_t i = 0;
+            while (i < nr && c < n && canIssue(blockId, maxBlockId)) {
+                prepareIo(blockId, bb_.next());
+                pending++;
+                c++;
+                i++;
+            }
+            submit(i);
         }
         /* Wait remaining. */
         while (pending > 0) {
@@ -542,34 +1156,41 @@ public:
     /**
      * @runPeriodInSec Run period [second].
      * @startBlockId Start block id [block].
+     * @endBlockId IOs will not be issued at or after the block [block].
      */
-    void execNsecs(size_t runPeriodInSec, size_t startBlockId) {
+    void execNsecs(size_t runPeriodInSec, size_t startBlockId,
+                   size_t endBlockId = SIZE_MAX) {
 
         size_t pending = 0;
         size_t blockId = startBlockId;
+        const size_t maxBlockId = std::min(maxBlockId_, endBlockId);
 
         double beginTime, endTime;
         beginTime = getTime();
         endTime = beginTime;
 
         /* Fill the queue. */
-        while (pending < queueSize_ && blockId < maxBlockId_) {
-            prepareIo(blockId++, bb_.next());
+        while (pending < queueSize_ && canIssue(blockId, maxBlockId)) {
+            prepareIo(blockId, bb_.next());
             pending++;
         }
-        aio_.submit();
+        submit(pending);
         /* Wait and fill. */
         while (endTime - beginTime < static_cast<double>(runPeriodInSec)
-               && blockId < maxBlockId_) {
+               && canIssue(blockId, maxBlockId)) {
 
             assert(pending == queueSize_);
 
-            endTime = waitAnIo();
-            pending--;
+            const size_t nr = waitIos(endTime);
+            pending -= nr;
 
-            prepareIo(blockId++, bb_.next());
-            pending++;
-            aio_.submit();
+            size_t i = 0;
+            while (i < nr && canIssue(blockId, maxBlockId)) {
+                prepareIo(blockId, bb_.next());
+                pending++;
+                i++;
+            }
+            submit(i);
         }
         /* Wait remaining. */
         while (pending > 0) {
@@ -586,6 +1207,22 @@ public:
         return stat_;
     }
 
+    /**
+     * Get the performance statistics of each IO size.
+     */
+    const std::vector<PerformanceStatistics>& getSizeStats() const {
+
+        return sizeStats_;
+    }
+
+    /**
+     * Get the performance statistics of each target.
+     */
+    const TargetStatistics& getTargetStats() const {
+
+        return targetStats_;
+    }
+
     /**
      * Get the log queue of the thread with 'id'.
      */
@@ -594,21 +1231,120 @@ public:
         return logQ_;
     }
 
+    /**
+     * Get the number of blocks in the device.
+     */
+    size_t getMaxBlockId() const {
+
+        return maxBlockId_;
+    }
+
+    /**
+     * Get distributions of completion/submission batch sizes.
+     */
+    const BatchStatistics& getReapStat() const { return reapStat_; }
+    const BatchStatistics& getSubmitStat() const { return submitStat_; }
+
 private:
-    void prepareIo(size_t blockId, char *buf) {
+    /**
+     * Move blockId to the start of the next chunk if the next IO crosses chunks.
+     * @return true if the next IO at blockId ends before maxBlockId.
+     */
+    bool canIssue(size_t& blockId, size_t maxBlockId) const {
+
+        blockId = targets_.fit(blockId * blockSize_, nextSize_) / blockSize_;
+        return blockId + nextSize_ / blockSize_ <= maxBlockId;
+    }
 
-        if (mode_ == WRITE_MODE) {
-            aio_.prepareWrite(blockId * blockSize_, blockSize_, buf);
+    /**
+     * Prepare the next IO at blockId and advance blockId past it.
+     */
+    void prepareIo(size_t& blockId, char *buf) {
+
+        throttle_.acquire(nextSize_);
+        const std::pair<size_t, uint64_t> loc = targets_.locate(blockId * blockSize_);
+        const off_t oft = loc.second;
+        aio_.selectFile(loc.first);
+        const int nrSegs = iovBuf_.getNrSegs();
+        if (nrSegs > 0) {
+            if (mode_ == WRITE_MODE) {
+                aio_.prepareWritev(oft, iovBuf_.next(), nrSegs);
+            } else {
+                aio_.prepareReadv(oft, iovBuf_.next(), nrSegs);
+            }
+        } else if (mode_ == WRITE_MODE) {
+            aio_.prepareWrite(oft, nextSize_, buf);
         } else {
-            aio_.prepareRead(blockId * blockSize_, blockSize_, buf);
+            aio_.prepareRead(oft, nextSize_, buf);
         }
+        blockId += nextSize_ / blockSize_;
+        nextSize_ = bsSplit_.pick(rand_);
+        submitIfPaced();
+    }
+
+    /**
+     * With a cap, submit the IO prepared just now as soon as its token is granted.
+     * Otherwise it would wait for the tokens of the rest of the batch,
+     * and the paced IOs would go out in bursts.
+     */
+    void submitIfPaced() {
+
+        if (!throttle_.isEnabled()) { return; }
+        aio_.submit();
+        if (batchSize_ > 1) { submitStat_.add(1); }
     }
 
     double waitAnIo() {
 
-        auto* ptr = aio_.waitOne();
+        return recordIo(aio_.waitOne());
+    }
+
+    /**
+     * Wait at least one and at most batchSize_ IO(s).
+     * @endTime the end time of the IOs will be set.
+     * @return number of completed IOs.
+     */
+    size_t waitIos(double& endTime) {
+
+        if (batchSize_ == 1) {
+            endTime = waitAnIo();
+            return 1;
+        }
+        const size_t nr = aio_.waitSome(batchSize_, doneV_);
+        for (AioData *ptr : doneV_) {
+            endTime = recordIo(ptr);
+        }
+        reapStat_.add(nr);
+        return nr;
+    }
+
+    /**
+     * Submit prepared IOs.
+     * @nr number of the IOs.
+     */
+    void submit(size_t nr) {
+
+        aio_.submit();
+        /*
+         * submit(0) only flushes leftovers and is not a batch,
+         * and paced IOs have been submitted one by one.
+         */
+        if (nr > 0 && batchSize_ > 1 && !throttle_.isEnabled()) { submitStat_.add(nr); }
+    }
+
+    /**
+     * @return end time of the IO.
+     */
+    double recordIo(AioData *ptr) {
+
         auto log = toIoLog(ptr);
         stat_.updateRt(log.response);
+        if (bsSplit_.isSplit()) {
+            sizeStats_[bsSplit_.getIndex(ptr->size)].updateRt(log.response);
+        }
+        if (targetStats_.isEnabled()) {
+            targetStats_.add(targets_.getId(ptr->fileIdx), ptr->size, log.response);
+        }
         if (isShowEachResponse_) {
             logQ_.push(log);
         }
@@ -617,7 +1353,7 @@ private:
 
     IoLog toIoLog(AioData *ptr) {
 
-        return IoLog(0, ptr->type, ptr->oft / ptr->size,
+        return IoLog(threadId_, ptr->type, ptr->oft / blockSize_,
                      ptr->beginTime, ptr->endTime - ptr->beginTime);
     }
 };
@@ -625,13 +1361,18 @@ private:
 /**
  * Use aio for parallel IO execution.
  */
+template <typename AsyncIo>
 void execAioExperiment(const Options& opt)
 {
-    AioThroughputBench bench(
-        opt.getArgs()[0], opt.getMode(), opt.getBlockSize(),
-        opt.getQueueSize(), opt.isShowEachResponse());
+    opt.affinityCfg.print(1, "threadId");
+    opt.affinityCfg.place(0);
+    AioThroughputBench<AsyncIo> bench(
+        opt.getArgs(), opt.getMode(), opt.bsSplit,
+        opt.getQueueSize(), opt.isShowEachResponse(), opt.asyncIoCfg,
+        opt.getBatchSize(), opt.vectorCfg, opt.getThrottle(), opt.placementCfg);
 
     double begin, end;
+    const CpuTime cpuBegin = CpuTime::getThread();
     begin = getTime();
     try {
         if (opt.getPeriod() > 0) {
@@ -639,10 +1380,11 @@ void execAioExperiment(const Options& opt)
         } else {
             bench.execNtimes(opt.getCount(), opt.getStartBlockId());
         }
-    } catch (const Aio::EofError& e) {
+    } catch (const typename AsyncIo::EofError& e) {
         ::printf("EofError.\n");
     }
     end = getTime();
+    const CpuTime cpuEnd = CpuTime::getThread();
 
     /* print each IO log. */
     if (opt.isShowEachResponse()) {
@@ -655,9 +1397,138 @@ void execAioExperiment(const Options& opt)
 
     /* Statistics */
     auto& stat = bench.getStat();
+    uint64_t bytes = opt.getBlockSize() * stat.getCount();
+    if (opt.bsSplit.isSplit()) {
+        bytes = printSizeStats(opt.bsSplit, bench.getSizeStats(), end - begin);
+    }
     ::printf("all ");
     stat.print();
-    printThroughput(opt.getBlockSize(), stat.getCount(), end - begin);
+    printDataThroughput(bytes, stat.getCount(), end - begin);
+    printCpuTime(cpuBegin, cpuEnd, stat.getCount());
+    if (opt.getBatchSize() > 1) {
+        bench.getReapStat().print("Reap batch");
+        bench.getSubmitStat().print("Submit batch");
+    }
+    if (opt.getArgs().size() > 1) {
+        bench.getTargetStats().print(opt.getArgs(), end - begin);
+    }
+}
+
+/**
+ * Use several aio contexts in parallel.
+ * Each worker issues IOs in its own partition of the range.
+ */
+template <typename AsyncIo>
+void execMultiAioExperiment(const Options& opt)
+{
+    typedef AioThroughputBench<AsyncIo> Bench;
+    const size_t nr = opt.getNthreads();
+    assert(nr > 0);
+
+    opt.affinityCfg.print(nr, "threadId");
+    std::vector<std::unique_ptr<Bench> > benches;
+    for (size_t i = 0; i < nr; i++) {
+        opt.affinityCfg.bindMemory(i);
+        benches.emplace_back(new Bench(
+            opt.getArgs(), opt.getMode(), opt.bsSplit,
+            opt.getQueueSize(), opt.isShowEachResponse(), opt.asyncIoCfg,
+            opt.getBatchSize(), opt.vectorCfg, opt.getThrottle(), opt.placementCfg, i));
+    }
+    opt.affinityCfg.unbindMemory();
+    const size_t startBlockId = opt.getStartBlockId();
+    size_t endBlockId = SIZE_MAX;
+    for (const auto& bench : benches) {
+        endBlockId = std::min(endBlockId, bench->getMaxBlockId());
+    }
+    if (opt.getPeriod() == 0) {
+        /* enough blocks for the IOs even if all of them are the largest. */
+        const size_t ratio = opt.bsSplit.getMax() / opt.bsSplit.getMin();
+        endBlockId = std::min(endBlockId, startBlockId + opt.getCount() * ratio);
+    }
+    if (endBlockId < startBlockId + nr) {
+        throw std::runtime_error("access range is too small for the threads.");
+    }
+    const size_t len = endBlockId - startBlockId;
+
+    std::vector<double> begins(nr), ends(nr);
+    std::vector<CpuTime> cpuBegins(nr), cpuEnds(nr);
+    std::vector<std::future<void> > workers;
+    const double begin = getTime();
+    for (size_t i = 0; i < nr; i++) {
+        workers.push_back(std::async(std::launch::async, [&, i] {
+                    opt.affinityCfg.place(i);
+                    const size_t bgnId = startBlockId + len * i / nr;
+                    const size_t endId = startBlockId + len * (i + 1) / nr;
+                    Bench& bench = *benches[i];
+                    cpuBegins[i] = CpuTime::getThread();
+                    begins[i] = getTime();
+                    try {
+                        if (opt.getPeriod() > 0) {
+                            bench.execNsecs(opt.getPeriod(), bgnId, endId);
+                        } else {
+                            const size_t count = opt.getCount();
+                            bench.execNtimes(count * (i + 1) / nr - count * i / nr,
+                                             bgnId, endId);
+                        }
+                    } catch (const typename AsyncIo::EofError& e) {
+                        ::printf("EofError.\n");
+                    }
+                    ends[i] = getTime();
+                    cpuEnds[i] = CpuTime::getThread();
+                }));
+    }
+    std::for_each(workers.begin(), workers.end(),
+                  [](std::future<void>& f) { f.get(); });
+    const double end = getTime();
+
+    /* print each IO log. */
+    if (opt.isShowEachResponse()) {
+        for (size_t i = 0; i < nr; i++) {
+            auto& logQ = benches[i]->getLogQueue();
+            while (!logQ.empty()) {
+                logQ.front().print();
+                logQ.pop();
+            }
+        }
+    }
+
+    /* Print statistics. */
+    std::vector<PerformanceStatistics> stats;
+    std::vector<std::vector<PerformanceStatistics> > sizeStatsV(opt.bsSplit.getNr());
+    TargetStatistics targetStats;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < nr; i++) {
+        auto& stat = benches[i]->getStat();
+        uint64_t threadBytes = 0;
+        for (size_t j = 0; j < opt.bsSplit.getNr(); j++) {
+            const PerformanceStatistics& sizeStat = benches[i]->getSizeStats()[j];
+            sizeStatsV[j].push_back(sizeStat);
+            threadBytes += opt.bsSplit.sizes[j] * sizeStat.getCount();
+        }
+        if (!opt.bsSplit.isSplit()) threadBytes = opt.getBlockSize() * stat.getCount();
+        bytes += threadBytes;
+        ::printf("threadId %zu ", i);
+        stat.print();
+        ::printf("threadId %zu ", i);
+        printDataThroughput(threadBytes, stat.getCount(), ends[i] - begins[i]);
+        ::printf("threadId %zu ", i);
+        printCpuTime(cpuBegins[i], cpuEnds[i], stat.getCount());
+        stats.push_back(stat);
+        targetStats.merge(benches[i]->getTargetStats());
+    }
+    auto stat = mergeStats(stats.begin(), stats.end());
+    ::printf("----------------\n");
+    if (opt.bsSplit.isSplit()) {
+        std::vector<PerformanceStatistics> sizeStats;
+        for (auto& v : sizeStatsV) sizeStats.push_back(mergeStats(v.begin(), v.end()));
+        printSizeStats(opt.bsSplit, sizeStats, end - begin);
+    }
+    ::printf("all ");
+    stat.print();
+    printDataThroughput(bytes, stat.getCount(), end - begin);
+    if (opt.getArgs().size() > 1) {
+        targetStats.print(opt.getArgs(), end - begin);
+    }
 }
 
 int main(int argc, char* argv[])
@@ -673,7 +1544,17 @@ int main(int argc, char* argv[])
             opt.showHelp();
         } else {
             if (opt.getNthreads() == 0) {
-                execAioExperiment(opt);
+                if (opt.getEngine() == ENGINE_URING) {
+                    execAioExperiment<IoUring>(opt);
+                } else {
+                    execAioExperiment<Aio>(opt);
+                }
+            } else if (opt.isAioPerThread()) {
+                if (opt.getEngine() == ENGINE_URING) {
+                    execMultiAioExperiment<IoUring>(opt);
+                } else {
+                    execMultiAioExperiment<Aio>(opt);
+                }
             } else {
                 execThreadExperiment(opt);
             }
@@ -57,3 +57,119 @@ public:
         return get() % max;
     }
 };
+
+/**
+ * xoshiro256** generator by Blackman and Vigna.
+ * It gives 64-bit values with period 2^256 - 1 in a few nanoseconds.
+ * jump() is equivalent to 2^128 calls of get(),
+ * so generators made by stream() do not overlap each other.
+ */
+class Xoshiro256
+{
+private:
+    uint64_t s_[4];
+
+public:
+    typedef uint64_t result_type;
+
+    explicit Xoshiro256(uint64_t seed) {
+
+        /* Expand the seed by splitmix64 as the authors recommend. */
+        for (int i = 0; i < 4; i++) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            s_[i] = z ^ (z >> 31);
+        }
+    }
+
+    /**
+     * Get the idx-th independent stream of a seed.
+     */
+    static Xoshiro256 stream(uint64_t seed, size_t idx) {
+
+        Xoshiro256 gen(seed);
+        for (size_t i = 0; i < idx; i++) {
+            gen.jump();
+        }
+        return gen;
+    }
+
+    uint64_t get() {
+
+        const uint64_t ret = rotl(s_[1] * 5, 7) * 9;
+        const uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return ret;
+    }
+
+    /**
+     * Get a value in [0, max) without bias
+     * by Lemire's multiply-and-reject method.
+     */
+    uint64_t get(uint64_t max) {
+
+        unsigned __int128 m = static_cast<unsigned __int128>(get()) * max;
+        uint64_t low = static_cast<uint64_t>(m);
+        if (low < max) {
+            const uint64_t threshold = -max % max;
+            while (low < threshold) {
+                m = static_cast<unsigned __int128>(get()) * max;
+                low = static_cast<uint64_t>(m);
+            }
+        }
+        return static_cast<uint64_t>(m >> 64);
+    }
+
+    /**
+     * Get a value in [0, 1) with 53-bit resolution.
+     */
+    double getDouble() {
+
+        return (get() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /**
+     * Fill an array with values in [0, max).
+     */
+    void fill(uint64_t *v, size_t n, uint64_t max) {
+
+        for (size_t i = 0; i < n; i++) {
+            v[i] = get(max);
+        }
+    }
+
+    void jump() {
+
+        static const uint64_t JUMP[] = {
+            0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+            0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+        uint64_t t[4] = {0, 0, 0, 0};
+        for (uint64_t j : JUMP) {
+            for (int b = 0; b < 64; b++) {
+                if (j & (1ULL << b)) {
+                    for (int i = 0; i < 4; i++) t[i] ^= s_[i];
+                }
+                get();
+            }
+        }
+        for (int i = 0; i < 4; i++) s_[i] = t[i];
+    }
+
+    /* UniformRandomBitGenerator interface for std distributions. */
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return UINT64_MAX; }
+    uint64_t operator()() { return get(); }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) {
+
+        return (x << k) | (x >> (64 - k));
+    }
+};
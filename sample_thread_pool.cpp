@@ -4,6 +4,7 @@
 #include "thread_pool.hpp"
 
 #include <cstdio>
+#include <cstdlib>
 #include <future>
 #include <memory>
 #include <functional>
@@ -56,8 +57,25 @@ void testThreadPoolWithTask()
     finalizer.join();
 }
 
+/**
+ * Exit when the number of tasks run differs from the expected.
+ */
+void checkTaskCount(const char *name, size_t count, size_t expected)
+{
+    if (count != expected) {
+        ::fprintf(stderr, "%s: %zu tasks run but %zu expected.\n", name, count, expected);
+        ::exit(1);
+    }
+}
+
+/**
+ * Every task accepted by submit() or submitBatch() must be run once.
+ * @batchSize number of tasks submitted/dequeued at once.
+ */
+template<typename Queue>
 size_t testThreadPoolOverhead(
-    int nEnqueThreads, int nDequeueThreads, int workQueueSize, int runPeriodMs)
+    int nEnqueThreads, int nDequeueThreads, int workQueueSize, int runPeriodMs,
+    unsigned int batchSize = 1)
 {
     std::atomic<size_t> count(0);
 
@@ -68,15 +86,21 @@ size_t testThreadPoolOverhead(
             } while(!count.compare_exchange_strong(s, s + 1));
         });
 
-    ThreadPool<int> threadPool(nDequeueThreads, workQueueSize, counter);
+    ThreadPool<int, Queue> threadPool(nDequeueThreads, workQueueSize, counter, batchSize);
 
     std::vector<std::thread> workers;
     std::atomic<bool> shouldStop(false);
+    std::atomic<size_t> accepted(0);
     for (int i = 0; i < nEnqueThreads; i ++) {
 
         std::thread th([&]{
+                const std::vector<int> batch(batchSize, 0);
                 while (!shouldStop.load()) {
-                    threadPool.submit(0);
+                    if (batchSize == 1) {
+                        if (threadPool.submit(0)) accepted++;
+                    } else {
+                        accepted += threadPool.submitBatch(batch.begin(), batch.end());
+                    }
                 }
             });
         workers.push_back(std::move(th));
@@ -90,7 +114,10 @@ size_t testThreadPoolOverhead(
         });
 
     threadPool.flush();
+    threadPool.stop();
+    threadPool.join();
     size_t total = count;
+    checkTaskCount("testThreadPoolOverhead", total, accepted.load());
     return total;
 }
 
@@ -113,6 +140,79 @@ void testThreadPoolWithId()
 }
 
 
+/**
+ * Tiny tasks submitted by nEnqueThreads to a work-stealing pool.
+ */
+size_t testWorkStealingOverhead(
+    int nEnqueThreads, int nDequeueThreads, int workQueueSize, int runPeriodMs)
+{
+    std::atomic<size_t> count(0);
+    std::function<void(int, unsigned int)> counter([&](int, unsigned int) { count++; });
+
+    WorkStealingThreadPool<int> threadPool(nDequeueThreads, workQueueSize, counter);
+
+    std::vector<std::thread> workers;
+    std::atomic<bool> shouldStop(false);
+    for (int i = 0; i < nEnqueThreads; i ++) {
+        workers.emplace_back([&]{
+                while (!shouldStop.load()) {
+                    threadPool.submit(0);
+                }
+            });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(runPeriodMs));
+    shouldStop.store(true);
+
+    std::for_each(workers.begin(), workers.end(), [](std::thread& th) {
+            th.join();
+        });
+
+    threadPool.flush();
+    size_t total = count;
+    return total;
+}
+
+/**
+ * Each task spawns two follow-up tasks until the depth.
+ * flush() waits for the follow-up tasks as well.
+ */
+void testWorkStealingFanOut(int nThreads, int depth)
+{
+    std::atomic<size_t> count(0);
+    std::vector<size_t> countPerThread(nThreads, 0);
+    WorkStealingThreadPool<int> *poolP = nullptr;
+    std::function<void(int, unsigned int)> f([&](int d, unsigned int id) {
+            count++;
+            countPerThread[id]++;
+            if (d < depth) {
+                poolP->submit(d + 1);
+                poolP->submit(d + 1);
+            }
+        });
+
+    WorkStealingThreadPool<int> threadPool(nThreads, 16, f);
+    poolP = &threadPool;
+    auto bgn = std::chrono::steady_clock::now();
+    threadPool.submit(0);
+    threadPool.flush();
+    auto end = std::chrono::steady_clock::now();
+    threadPool.stop();
+    threadPool.join();
+    threadPool.get();
+
+    const size_t expected = (size_t(1) << (depth + 1)) - 1;
+    printf("testWorkStealingFanOut %zu tasks (expected %zu) in %.3f sec with %d threads:",
+           count.load(), expected,
+           std::chrono::duration_cast<std::chrono::duration<double> >(end - bgn).count(),
+           nThreads);
+    for (size_t c : countPerThread) {
+        printf(" %zu", c);
+    }
+    printf("\n");
+    checkTaskCount("testWorkStealingFanOut", count.load(), expected);
+}
+
 void testCounterWithCas(int nThreads, size_t runPeriod)
 {
     // Performance of counter with CAS.
@@ -180,19 +280,48 @@ int main()
                     size_t nDeq = j + 1;
                     int queueSize = (k + 1) * 8;
                     printf("%zu %zu %2d %10zu\n", nEnq, nDeq, queueSize,
-                           testThreadPoolOverhead(nEnq, nDeq, queueSize, 1000));
+                           testThreadPoolOverhead<thread_pool::LockedQueue<int> >(
+                               nEnq, nDeq, queueSize, 1000));
                 }
             }
         }
     }
 #endif
+#if 1
+    {
+        /* mutex queue vs lock-free ring queue, one by one and in batches. */
+        for (int nThreads = 1; nThreads <= 4; nThreads *= 2) {
+            for (unsigned int batchSize = 1; batchSize <= 16; batchSize *= 16) {
+                const int queueSize = 256;
+                const size_t locked = testThreadPoolOverhead<thread_pool::LockedQueue<int> >(
+                    nThreads, nThreads, queueSize, 1000, batchSize);
+                const size_t ring = testThreadPoolOverhead<thread_pool::RingQueue<int> >(
+                    nThreads, nThreads, queueSize, 1000, batchSize);
+                printf("nEnq %d nDeq %d batch %2u locked %10zu ring %10zu\n",
+                       nThreads, nThreads, batchSize, locked, ring);
+            }
+        }
+    }
+#endif
+#if 1
+    {
+        for (int nThreads = 1; nThreads <= 4; nThreads *= 2) {
+            printf("nEnq %d nDeq %d locked %10zu workStealing %10zu\n", nThreads, nThreads,
+                   testThreadPoolOverhead<thread_pool::LockedQueue<int> >(
+                       nThreads, nThreads, 256, 1000),
+                   testWorkStealingOverhead(nThreads, nThreads, 256, 1000));
+        }
+        testWorkStealingFanOut(4, 18);
+    }
+#endif
 #if 0
     {
         int nEnq = 1;
         int nDeq = 1;
         int queueSize = 16;
         int runPeriodMs = 5000;
-        size_t count = testThreadPoolOverhead(nEnq, nDeq, queueSize, runPeriodMs);
+        size_t count = testThreadPoolOverhead<thread_pool::LockedQueue<int> >(
+            nEnq, nDeq, queueSize, runPeriodMs);
         printf("nEnq %d nDeq %d qSize %2d count %10zu ops %10zu\n",
                nEnq, nDeq, queueSize, count, count / (runPeriodMs / 1000));
     }
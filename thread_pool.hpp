@@ -10,12 +10,17 @@
 #include <future>
 #include <iterator>
 #include <list>
+#include <deque>
 #include <map>
 #include <queue>
 #include <functional>
 #include <algorithm>
 #include <memory>
+#include <atomic>
+#include <vector>
+#include <random>
 #include <cstdio>
+#include <cstdint>
 #include <cassert>
 
 /**
@@ -26,19 +31,427 @@ namespace thread_pool {
 
 class ShouldStopException : public std::exception {};
 
+/**
+ * Bounded blocking queue guarded by a mutex.
+ * This is the default queue of thread pools.
+ */
 template<typename T>
-class ThreadPoolBase
+class LockedQueue
 {
-protected:
-    const unsigned int poolSize_;
-    const unsigned int queueSize_;
+private:
+    const size_t capacity_;
 
     std::mutex mutex_;
     std::condition_variable cvEmpty_; // wait for empty -> not empty.
     std::condition_variable cvFull_;  // wait for full -> not full.
     std::condition_variable cvFlush_; // wait for not empty -> empty.
     bool shouldStop_; // protected by the mutex.
-    std::queue<T> waitQ_; // protected by the mutex.
+    std::queue<T> q_; // protected by the mutex.
+
+public:
+    explicit LockedQueue(size_t capacity)
+        : capacity_(capacity)
+        , shouldStop_(false) {}
+
+    /**
+     * Push an item waiting while the queue is full.
+     * RETURN:
+     * false if the queue has been stopped.
+     */
+    bool push(const T& item) {
+
+        return pushBatch(&item, &item + 1) == 1;
+    }
+
+    /**
+     * Push items with one lock as long as the queue has room.
+     * RETURN:
+     * number of pushed items, which is less than the given ones
+     * if the queue has been stopped.
+     */
+    template<typename It>
+    size_t pushBatch(It begin, It end) {
+
+        std::unique_lock<std::mutex> lk(mutex_);
+        size_t n = 0;
+        for (It it = begin; it != end; ++it) {
+            while (q_.size() >= capacity_ && !shouldStop_) {
+                cvEmpty_.notify_all();
+                cvFull_.wait(lk);
+            }
+            if (shouldStop_) { break; }
+            q_.push(*it);
+            n++;
+        }
+        if (n == 1) {
+            cvEmpty_.notify_one();
+        } else if (n > 1) {
+            cvEmpty_.notify_all();
+        }
+        return n;
+    }
+
+    /**
+     * Pop an item waiting while the queue is empty.
+     * RETURN:
+     * false if the queue has been stopped.
+     */
+    bool pop(T& item) {
+
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (!waitNotEmpty(lk)) { return false; }
+        item = std::move(q_.front());
+        q_.pop();
+        afterPop(1);
+        return true;
+    }
+
+    /**
+     * Pop at most max items with one lock waiting while the queue is empty.
+     * @items will be replaced with the popped items.
+     * RETURN:
+     * number of the popped items, or 0 if the queue has been stopped.
+     */
+    size_t popBatch(std::vector<T>& items, size_t max) {
+
+        items.clear();
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (!waitNotEmpty(lk)) { return 0; }
+        while (!q_.empty() && items.size() < max) {
+            items.push_back(std::move(q_.front()));
+            q_.pop();
+        }
+        afterPop(items.size());
+        return items.size();
+    }
+
+    /**
+     * Wait until the queue gets empty.
+     * RETURN:
+     * false if the queue has been stopped.
+     */
+    bool waitEmpty() {
+
+        std::unique_lock<std::mutex> lk(mutex_);
+        while (!q_.empty() && !shouldStop_) {
+            cvFlush_.wait(lk);
+        }
+        return !shouldStop_;
+    }
+
+    /**
+     * Wake up all the waiters, which will fail.
+     */
+    void stop() {
+
+        std::unique_lock<std::mutex> lk(mutex_);
+        shouldStop_ = true;
+        cvEmpty_.notify_all();
+        cvFull_.notify_all();
+        cvFlush_.notify_all();
+    }
+
+private:
+    bool waitNotEmpty(std::unique_lock<std::mutex>& lk) {
+
+        while (q_.empty() && !shouldStop_) {
+            cvEmpty_.wait(lk);
+        }
+        return !shouldStop_;
+    }
+
+    void afterPop(size_t n) {
+
+        if (n == 1) {
+            cvFull_.notify_one();
+        } else {
+            cvFull_.notify_all();
+        }
+        if (q_.empty()) { cvFlush_.notify_all(); }
+    }
+};
+
+/**
+ * Bounded lock-free MPMC queue on a ring buffer
+ * (Dmitry Vyukov's algorithm: each cell has a sequence number
+ * that tells whether it is ready to push or to pop).
+ * Its capacity is the given one rounded up to a power of two.
+ *
+ * Waiters spin for a while and then park on a condition variable.
+ * Pushers and poppers take the mutex only when someone is parked,
+ * so the queue is lock-free while it is neither empty nor full.
+ */
+template<typename T>
+class RingQueue
+{
+private:
+    static const size_t CACHE_LINE_SIZE = 64;
+    static const size_t SPIN_COUNT = 64; /* busy loops before yielding. */
+    static const size_t YIELD_COUNT = 16; /* yields before parking. */
+
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T item;
+    };
+
+    std::vector<Cell> cells_;
+    const size_t mask_;
+    char pad0_[CACHE_LINE_SIZE];
+    std::atomic<size_t> pushPos_;
+    char pad1_[CACHE_LINE_SIZE];
+    std::atomic<size_t> popPos_;
+    char pad2_[CACHE_LINE_SIZE];
+
+    const bool shouldSpin_; /* spinning is useless with one cpu. */
+    std::atomic<bool> shouldStop_;
+    std::atomic<size_t> nrPushWaiters_;
+    std::atomic<size_t> nrPopWaiters_;
+    std::atomic<size_t> nrFlushWaiters_;
+    std::mutex mutex_; // only to park.
+    std::condition_variable cvEmpty_; // wait for empty -> not empty.
+    std::condition_variable cvFull_;  // wait for full -> not full.
+    std::condition_variable cvFlush_; // wait for not empty -> empty.
+
+public:
+    explicit RingQueue(size_t capacity)
+        : cells_(roundUp(capacity))
+        , mask_(cells_.size() - 1)
+        , pushPos_(0)
+        , popPos_(0)
+        , shouldSpin_(std::thread::hardware_concurrency() > 1)
+        , shouldStop_(false)
+        , nrPushWaiters_(0)
+        , nrPopWaiters_(0)
+        , nrFlushWaiters_(0) {
+
+        for (size_t i = 0; i < cells_.size(); i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Push an item waiting while the queue is full.
+     * RETURN:
+     * false if the queue has been stopped.
+     */
+    bool push(const T& item) {
+
+        return pushBatch(&item, &item + 1) == 1;
+    }
+
+    /**
+     * Push items waking up parked poppers once.
+     * RETURN:
+     * number of pushed items, which is less than the given ones
+     * if the queue has been stopped.
+     */
+    template<typename It>
+    size_t pushBatch(It begin, It end) {
+
+        size_t n = 0;
+        for (It it = begin; it != end; ++it) {
+            if (!tryPush(*it)) {
+                if (n > 0) { wake(nrPopWaiters_, cvEmpty_); }
+                if (!waitFor(nrPushWaiters_, cvFull_, [&] { return tryPush(*it); })) {
+                    break;
+                }
+            }
+            n++;
+        }
+        if (n > 0) { wake(nrPopWaiters_, cvEmpty_); }
+        return n;
+    }
+
+    /**
+     * Pop an item waiting while the queue is empty.
+     * RETURN:
+     * false if the queue has been stopped.
+     */
+    bool pop(T& item) {
+
+        if (!waitFor(nrPopWaiters_, cvEmpty_, [&] { return tryPop(item); })) {
+            return false;
+        }
+        afterPop();
+        return true;
+    }
+
+    /**
+     * Pop at most max items waiting while the queue is empty.
+     * @items will be replaced with the popped items.
+     * RETURN:
+     * number of the popped items, or 0 if the queue has been stopped.
+     */
+    size_t popBatch(std::vector<T>& items, size_t max) {
+
+        items.clear();
+        T item;
+        if (!waitFor(nrPopWaiters_, cvEmpty_, [&] { return tryPop(item); })) {
+            return 0;
+        }
+        items.push_back(std::move(item));
+        while (items.size() < max && tryPop(item)) {
+            items.push_back(std::move(item));
+        }
+        afterPop();
+        return items.size();
+    }
+
+    /**
+     * Wait until the queue gets empty.
+     * RETURN:
+     * false if the queue has been stopped.
+     */
+    bool waitEmpty() {
+
+        waitFor(nrFlushWaiters_, cvFlush_, [&] { return isEmpty(); });
+        return !shouldStop_.load();
+    }
+
+    /**
+     * Wake up all the waiters, which will fail.
+     */
+    void stop() {
+
+        shouldStop_.store(true);
+        std::unique_lock<std::mutex> lk(mutex_);
+        cvEmpty_.notify_all();
+        cvFull_.notify_all();
+        cvFlush_.notify_all();
+    }
+
+private:
+    static size_t roundUp(size_t capacity) {
+
+        size_t size = 2;
+        while (size < capacity) { size *= 2; }
+        return size;
+    }
+
+    static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    bool isEmpty() const {
+
+        return popPos_.load() == pushPos_.load();
+    }
+
+    bool tryPush(const T& item) {
+
+        size_t pos = pushPos_.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0) {
+                if (pushPos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false; // full.
+            } else {
+                pos = pushPos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->item = item;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item) {
+
+        size_t pos = popPos_.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (popPos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false; // empty.
+            } else {
+                pos = popPos_.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->item);
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Spin, yield, and then park until pred() gets true.
+     * A waker changes the state and then checks the number of waiters,
+     * and a waiter counts itself and then checks the state,
+     * so either of them sees the other.
+     * RETURN:
+     * false if the queue has been stopped.
+     */
+    template<typename Pred>
+    bool waitFor(std::atomic<size_t>& nrWaiters, std::condition_variable& cv, Pred pred) {
+
+        const size_t nrSpins = shouldSpin_ ? SPIN_COUNT : 0;
+        for (size_t i = 0; i < nrSpins + YIELD_COUNT; i++) {
+            if (shouldStop_.load(std::memory_order_relaxed)) { return false; }
+            if (pred()) { return true; }
+            if (i < nrSpins) {
+                cpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        std::unique_lock<std::mutex> lk(mutex_);
+        nrWaiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool ret;
+        for (;;) {
+            if (shouldStop_.load()) { ret = false; break; }
+            if (pred()) { ret = true; break; }
+            cv.wait(lk);
+        }
+        nrWaiters.fetch_sub(1);
+        return ret;
+    }
+
+    void wake(std::atomic<size_t>& nrWaiters, std::condition_variable& cv) {
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (nrWaiters.load(std::memory_order_relaxed) > 0) {
+            std::unique_lock<std::mutex> lk(mutex_);
+            cv.notify_all();
+        }
+    }
+
+    void afterPop() {
+
+        wake(nrPushWaiters_, cvFull_);
+        if (isEmpty()) { wake(nrFlushWaiters_, cvFlush_); }
+    }
+};
+
+/**
+ * Queue is the queue of tasks:
+ * LockedQueue<T> (default) or RingQueue<T>.
+ */
+template<typename T, typename Queue = LockedQueue<T> >
+class ThreadPoolBase
+{
+protected:
+    const unsigned int poolSize_;
+    const unsigned int queueSize_;
+    const unsigned int batchSize_;
+
+    std::atomic<bool> shouldStop_;
+    Queue waitQ_;
 
     std::vector<std::thread> workers_;
 
@@ -50,11 +463,14 @@ public:
      * Constructor.
      * @poolSize Number of worker threads.
      * @queueSize Maximum length of queue.
+     * @batchSize Maximum number of tasks a worker dequeues at once.
      */
-    ThreadPoolBase(unsigned int poolSize, unsigned int queueSize)
+    ThreadPoolBase(unsigned int poolSize, unsigned int queueSize, unsigned int batchSize)
         : poolSize_(poolSize)
         , queueSize_(queueSize)
+        , batchSize_(batchSize)
         , shouldStop_(false)
+        , waitQ_(queueSize)
         , canSubmit_(true)  {}
 
     virtual ~ThreadPoolBase() throw() {
@@ -71,12 +487,27 @@ public:
     bool submit(T task) {
 
         if (canSubmit_.load()) {
-            return enqueue(task);
+            return waitQ_.push(task);
         } else {
             return false;
         }
     }
 
+    /**
+     * Submit tasks in [begin, end) at once.
+     * RETURN:
+     * number of submitted tasks.
+     */
+    template<typename It>
+    size_t submitBatch(It begin, It end) {
+
+        if (canSubmit_.load()) {
+            return waitQ_.pushBatch(begin, end);
+        } else {
+            return 0;
+        }
+    }
+
     /**
      * Flush all tasks pending/running.
      * submit() call is prehibited during flushing.
@@ -87,12 +518,9 @@ public:
     bool flush() {
 
         canSubmit_.store(false);
-        std::unique_lock<std::mutex> lk(mutex_);
-        while (!waitQ_.empty() && !shouldStop_) {
-            cvFlush_.wait(lk);
-        }
+        const bool ret = waitQ_.waitEmpty();
         canSubmit_.store(true);
-        return !shouldStop_;
+        return ret;
     }
 
     /**
@@ -100,11 +528,8 @@ public:
      */
     void stop() {
 
-        std::unique_lock<std::mutex> lk(mutex_);
-        shouldStop_ = true;
-        cvEmpty_.notify_all();
-        cvFull_.notify_all();
-        cvFlush_.notify_all();
+        shouldStop_.store(true);
+        waitQ_.stop();
     }
 
     /**
@@ -130,37 +555,24 @@ protected:
         }
     }
 
-    bool enqueue(T task) {
-
-        std::unique_lock<std::mutex> lk(mutex_);
+    T dequeue() {
 
-        while (waitQ_.size() >= queueSize_ && !shouldStop_) {
-            cvFull_.wait(lk);
-        }
-        if (shouldStop_) {
-            return false;
-        } else {
-            cvEmpty_.notify_one();
-            waitQ_.push(task);
-            return true;
+        T task;
+        if (!waitQ_.pop(task)) {
+            throw ShouldStopException();
         }
+        return task;
     }
 
-    T dequeue() {
-
-        std::unique_lock<std::mutex> lk(mutex_);
+    /**
+     * Dequeue at most batchSize_ tasks.
+     * The tasks should be run even if stop() is called meanwhile
+     * because flush() regards them as done.
+     */
+    void dequeueBatch(std::vector<T>& tasks) {
 
-        while (waitQ_.empty() && !shouldStop_) {
-            cvEmpty_.wait(lk);
-        }
-        if (shouldStop_) {
+        if (waitQ_.popBatch(tasks, batchSize_) == 0) {
             throw ShouldStopException();
-        } else {
-            cvFull_.notify_one();
-            T task = waitQ_.front();
-            waitQ_.pop();
-            if (waitQ_.empty()) { cvFlush_.notify_all(); }
-            return task;
         }
     }
 };
@@ -174,17 +586,17 @@ protected:
  * Currently worker function could not throw exceptions.
  * Use ThreadPoolWithId instead.
  */
-template<typename T>
-class ThreadPool : public thread_pool::ThreadPoolBase<T>
+template<typename T, typename Queue = thread_pool::LockedQueue<T> >
+class ThreadPool : public thread_pool::ThreadPoolBase<T, Queue>
 {
 private:
-    typedef thread_pool::ThreadPoolBase<T> TPB;
+    typedef thread_pool::ThreadPoolBase<T, Queue> TPB;
     std::function<void(T)> workerFunc_;
 
 public:
     ThreadPool(unsigned int poolSize, unsigned int queueSize,
-               const std::function<void(T)>& workerFunc)
-        : TPB(poolSize, queueSize)
+               const std::function<void(T)>& workerFunc, unsigned int batchSize = 1)
+        : TPB(poolSize, queueSize, batchSize)
         , workerFunc_(workerFunc) {
 
         TPB::init([&] { this->do_work(); });
@@ -195,12 +607,16 @@ public:
 private:
     void do_work() throw() {
 
+        std::vector<T> tasks;
         while (!TPB::shouldStop_) {
             try {
-                workerFunc_(TPB::dequeue());
+                TPB::dequeueBatch(tasks);
             } catch (thread_pool::ShouldStopException& e) {
                 break;
             }
+            for (T& task : tasks) {
+                workerFunc_(task);
+            }
         }
     }
 };
@@ -210,11 +626,11 @@ private:
  * Simple thread pool with thread id and promise data.
  * Wroker function can throw an exception and you can get it by get().
  */
-template<typename T>
-class ThreadPoolWithId : public thread_pool::ThreadPoolBase<T>
+template<typename T, typename Queue = thread_pool::LockedQueue<T> >
+class ThreadPoolWithId : public thread_pool::ThreadPoolBase<T, Queue>
 {
 private:
-    typedef thread_pool::ThreadPoolBase<T> TPB;
+    typedef thread_pool::ThreadPoolBase<T, Queue> TPB;
 
     std::mutex mutex_;
     std::condition_variable cv_;
@@ -222,6 +638,8 @@ private:
 
     /* The second is thread id starting from 0. */
     std::function<void(T, unsigned int)> workerFuncWithId_;
+    /* Called by each thread with its id before any task (e.g. to pin it). */
+    std::function<void(unsigned int)> initFunc_;
 
     std::map<std::thread::id, unsigned int> idMap_;
     std::vector<std::promise<void> > promises_;
@@ -229,10 +647,13 @@ private:
 
 public:
     ThreadPoolWithId(unsigned int poolSize, unsigned int queueSize,
-                     const std::function<void(T, unsigned int)>& workerFuncWithId)
-        : TPB(poolSize, queueSize)
+                     const std::function<void(T, unsigned int)>& workerFuncWithId,
+                     unsigned int batchSize = 1,
+                     const std::function<void(unsigned int)>& initFunc = nullptr)
+        : TPB(poolSize, queueSize, batchSize)
         , isInitialized_(false)
         , workerFuncWithId_(workerFuncWithId)
+        , initFunc_(initFunc)
         , promises_(poolSize)
         , futures_(poolSize) {
 
@@ -306,13 +727,17 @@ private:
         unsigned int id = idMap_[tid];
 
         try {
+            if (initFunc_) { initFunc_(id); }
+            std::vector<T> tasks;
             while (!TPB::shouldStop_) {
                 try {
-                    workerFuncWithId_(TPB::dequeue(), id);
-
+                    TPB::dequeueBatch(tasks);
                 } catch (thread_pool::ShouldStopException& e) {
                     break;
                 }
+                for (T& task : tasks) {
+                    workerFuncWithId_(task, id);
+                }
             }
             promises_[id].set_value();
         } catch (...) {
@@ -338,6 +763,377 @@ private:
 };
 
 
+namespace thread_pool {
+
+/**
+ * Deque of a worker in WorkStealingThreadPool.
+ * The owner pushes and pops at the back so that follow-up tasks run soon
+ * on the same cpu, and thieves steal the oldest tasks from the front.
+ * The mutex is rarely contended because thieves come only when idle.
+ */
+template<typename T>
+class WorkerDeque
+{
+private:
+    std::mutex mutex_;
+    std::deque<T> q_;
+
+public:
+    void push(const T& task) {
+
+        std::unique_lock<std::mutex> lk(mutex_);
+        q_.push_back(task);
+    }
+
+    bool pop(T& task) {
+
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (q_.empty()) { return false; }
+        task = std::move(q_.back());
+        q_.pop_back();
+        return true;
+    }
+
+    bool steal(T& task) {
+
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (q_.empty()) { return false; }
+        task = std::move(q_.front());
+        q_.pop_front();
+        return true;
+    }
+};
+
+} // namespace thread_pool
+
+
+/**
+ * Work-stealing thread pool with the same worker id contract as ThreadPoolWithId.
+ * Each worker has its own deque, and an idle worker steals tasks
+ * from the others starting at a random victim.
+ *
+ * A task submitted by a worker goes to the worker's own deque
+ * and is never blocked by queueSize, so that tasks can spawn follow-up tasks.
+ * Tasks submitted by other threads are distributed in round robin.
+ * Do not call flush() in worker threads.
+ */
+template<typename T>
+class WorkStealingThreadPool
+{
+private:
+    typedef thread_pool::WorkerDeque<T> Deque;
+
+    const unsigned int poolSize_;
+    const unsigned int queueSize_;
+
+    /* The second is thread id starting from 0. */
+    std::function<void(T, unsigned int)> workerFuncWithId_;
+
+    std::vector<std::unique_ptr<Deque> > deques_;
+    std::atomic<size_t> nrQueued_; /* tasks in the deques. */
+    std::atomic<size_t> nrPending_; /* tasks queued or running. */
+    std::atomic<size_t> nextDeque_;
+    std::atomic<bool> shouldStop_;
+    std::atomic<bool> canSubmit_;
+
+    /*
+     * Waiters count themselves before checking the state,
+     * and wakers change the state before checking the counts.
+     */
+    std::mutex mutex_; // only to park.
+    std::condition_variable cvEmpty_; // idle workers wait for tasks.
+    std::condition_variable cvFull_;  // submitters wait for room.
+    std::condition_variable cvFlush_; // flushers wait for no pending tasks.
+    std::atomic<size_t> nrIdle_;
+    std::atomic<size_t> nrFullWaiters_;
+    std::atomic<size_t> nrFlushWaiters_;
+    bool isInitialized_;
+    std::condition_variable cvInit_;
+
+    std::vector<std::thread> workers_;
+    std::map<std::thread::id, unsigned int> idMap_;
+    std::vector<std::promise<void> > promises_;
+    std::vector<std::future<void> > futures_;
+    std::once_flag joinFlag_;
+
+public:
+    /**
+     * Constructor.
+     * @poolSize Number of worker threads.
+     * @queueSize Maximum number of queued tasks submitted by non-worker threads.
+     */
+    WorkStealingThreadPool(unsigned int poolSize, unsigned int queueSize,
+                           const std::function<void(T, unsigned int)>& workerFuncWithId)
+        : poolSize_(poolSize)
+        , queueSize_(queueSize)
+        , workerFuncWithId_(workerFuncWithId)
+        , deques_()
+        , nrQueued_(0)
+        , nrPending_(0)
+        , nextDeque_(0)
+        , shouldStop_(false)
+        , canSubmit_(true)
+        , nrIdle_(0)
+        , nrFullWaiters_(0)
+        , nrFlushWaiters_(0)
+        , isInitialized_(false)
+        , promises_(poolSize)
+        , futures_(poolSize) {
+
+        for (unsigned int i = 0; i < poolSize; i++) {
+            deques_.emplace_back(new Deque());
+            futures_[i] = promises_[i].get_future();
+        }
+        for (unsigned int i = 0; i < poolSize; i++) {
+            workers_.emplace_back([this, i] { this->do_work(i); });
+            idMap_[workers_.back().get_id()] = i;
+        }
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            isInitialized_ = true;
+            cvInit_.notify_all();
+        }
+    }
+
+    ~WorkStealingThreadPool() throw() {
+
+        stop();
+        join();
+
+        bool canThrow = false;
+        getDetail(canThrow);
+    }
+
+    /**
+     * Submit a task.
+     * RETURN:
+     * true in success, or false.
+     */
+    bool submit(T task) {
+
+        unsigned int idx;
+        auto it = idMap_.find(std::this_thread::get_id());
+        if (it == idMap_.end()) {
+            if (!canSubmit_.load() || !reserve()) { return false; }
+            idx = nextDeque_.fetch_add(1) % poolSize_;
+        } else {
+            if (shouldStop_.load()) { return false; }
+            nrQueued_.fetch_add(1);
+            idx = it->second;
+        }
+        nrPending_.fetch_add(1);
+        deques_[idx]->push(task);
+        if (nrIdle_.load() > 0) {
+            std::unique_lock<std::mutex> lk(mutex_);
+            cvEmpty_.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * Submit tasks in [begin, end).
+     * RETURN:
+     * number of submitted tasks.
+     */
+    template<typename It>
+    size_t submitBatch(It begin, It end) {
+
+        size_t n = 0;
+        for (It it = begin; it != end; ++it) {
+            if (!submit(*it)) { break; }
+            n++;
+        }
+        return n;
+    }
+
+    /**
+     * Wait until all the tasks including follow-up ones are done.
+     * submit() call by non-worker threads is prehibited during flushing.
+     *
+     * RETURN:
+     * false when stop() is called dring flushing.
+     */
+    bool flush() {
+
+        canSubmit_.store(false);
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            nrFlushWaiters_.fetch_add(1);
+            while (nrPending_.load() > 0 && !shouldStop_.load()) {
+                cvFlush_.wait(lk);
+            }
+            nrFlushWaiters_.fetch_sub(1);
+        }
+        canSubmit_.store(true);
+        return !shouldStop_.load();
+    }
+
+    /**
+     * Stop all threads as soon as possible.
+     * Queued tasks will be discarded.
+     */
+    void stop() {
+
+        shouldStop_.store(true);
+        std::unique_lock<std::mutex> lk(mutex_);
+        cvEmpty_.notify_all();
+        cvFull_.notify_all();
+        cvFlush_.notify_all();
+    }
+
+    /**
+     * Join threads.
+     */
+    void join() {
+
+        std::call_once(joinFlag_, [&]() {
+                std::for_each(workers_.begin(), workers_.end(), [](std::thread& th) {
+                        th.join();
+                    });
+            });
+    }
+
+    /**
+     * Wait for all threads end.
+     * An exception will be thrown.
+     * You can call this mutliple times to get multiple exceptions.
+     * You need call this 'poolSize' times at most to get all exceptions.
+     */
+    void get() {
+
+        bool canThrow = true;
+        getDetail(canThrow);
+    }
+
+    /**
+     * Wait until a time point or all threads done.
+     */
+    void waitUntil(const std::chrono::steady_clock::time_point& time) {
+
+        std::for_each(futures_.begin(), futures_.end(), [&] (std::future<void>& f) {
+                f.wait_until(time);
+            });
+    }
+
+    /**
+     * Wait for a timeout period or all threads done.
+     */
+    void waitFor(const std::chrono::steady_clock::duration& period) {
+
+        waitUntil(std::chrono::steady_clock::now() + period);
+    }
+
+private:
+    void do_work(unsigned int id) throw() {
+
+        {
+            /* Wait for idMap_ filled. */
+            std::unique_lock<std::mutex> lk(mutex_);
+            while (!isInitialized_) {
+                cvInit_.wait(lk);
+            }
+        }
+        try {
+            std::minstd_rand rand(id + 1);
+            T task;
+            while (!shouldStop_.load()) {
+                if (!getTask(id, rand, task)) {
+                    park();
+                    continue;
+                }
+                workerFuncWithId_(task, id);
+                done();
+            }
+            promises_[id].set_value();
+        } catch (...) {
+            promises_[id].set_exception(std::current_exception());
+            stop();
+        }
+    }
+
+    /**
+     * Reserve a room for a task submitted by a non-worker thread.
+     */
+    bool reserve() {
+
+        size_t n = nrQueued_.load();
+        for (;;) {
+            if (shouldStop_.load()) { return false; }
+            if (n < queueSize_) {
+                if (nrQueued_.compare_exchange_weak(n, n + 1)) { return true; }
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(mutex_);
+            nrFullWaiters_.fetch_add(1);
+            while (nrQueued_.load() >= queueSize_ && !shouldStop_.load()) {
+                cvFull_.wait(lk);
+            }
+            nrFullWaiters_.fetch_sub(1);
+            n = nrQueued_.load();
+        }
+    }
+
+    /**
+     * Pop the newest task of its own, or steal the oldest one of another worker.
+     */
+    bool getTask(unsigned int id, std::minstd_rand& rand, T& task) {
+
+        bool found = deques_[id]->pop(task);
+        if (!found && poolSize_ > 1) {
+            const unsigned int start = rand() % poolSize_;
+            for (unsigned int i = 0; i < poolSize_ && !found; i++) {
+                const unsigned int victim = (start + i) % poolSize_;
+                found = victim != id && deques_[victim]->steal(task);
+            }
+        }
+        if (!found) { return false; }
+        nrQueued_.fetch_sub(1);
+        if (nrFullWaiters_.load() > 0) {
+            std::unique_lock<std::mutex> lk(mutex_);
+            cvFull_.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * A task may be counted but not pushed yet,
+     * so it returns as soon as any task is counted and the caller will retry.
+     */
+    void park() {
+
+        std::unique_lock<std::mutex> lk(mutex_);
+        nrIdle_.fetch_add(1);
+        while (nrQueued_.load() == 0 && !shouldStop_.load()) {
+            cvEmpty_.wait(lk);
+        }
+        nrIdle_.fetch_sub(1);
+    }
+
+    void done() {
+
+        if (nrPending_.fetch_sub(1) == 1 && nrFlushWaiters_.load() > 0) {
+            std::unique_lock<std::mutex> lk(mutex_);
+            cvFlush_.notify_all();
+        }
+    }
+
+    void getDetail(bool canThrow) {
+
+        std::for_each(futures_.begin(), futures_.end(), [&] (std::future<void>& f) {
+                if (f.valid()) {
+                    try {
+                        f.get();
+                    } catch (...) {
+                        if (canThrow) {
+                            std::rethrow_exception(std::current_exception());
+                        }
+                    }
+                }
+            });
+    }
+};
+
+
 namespace thread_pool {
 
 /**
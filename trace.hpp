@@ -0,0 +1,258 @@
+#pragma once
+/**
+ * @file
+ * @brief IO traces to replay.
+ */
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <linux/blktrace_api.h>
+#include "util.hpp"
+
+
+/**
+ * An IO in a trace.
+ */
+struct TraceRecord
+{
+    unsigned int threadId; /* 0 to the number of threads - 1. */
+    IoType type;
+    uint64_t oft; /* [byte] */
+    size_t size; /* [byte] */
+    double startTime; /* [sec] from the first IO. */
+    double response; /* recorded [sec]. negative means unknown. */
+};
+
+namespace trace_local {
+
+/**
+ * Sort records by the start time, make the first start at 0,
+ * and renumber threads from 0 in order of their ids.
+ */
+inline void normalize(std::vector<TraceRecord>& v)
+{
+    std::stable_sort(v.begin(), v.end(), [](const TraceRecord& a, const TraceRecord& b) {
+            return a.startTime < b.startTime;
+        });
+    std::map<unsigned int, unsigned int> ids;
+    for (const TraceRecord& rec : v) ids.emplace(rec.threadId, 0);
+    unsigned int i = 0;
+    for (auto& p : ids) p.second = i++;
+    const double base = v.empty() ? 0.0 : v[0].startTime;
+    for (TraceRecord& rec : v) {
+        rec.startTime -= base;
+        rec.threadId = ids[rec.threadId];
+    }
+}
+
+/**
+ * Parse a line printed by IoLog::print().
+ * @return false if the line is not an IO log.
+ */
+inline bool parseIoLog(const std::string& line, size_t blockSize, TraceRecord& rec)
+{
+    unsigned int threadId;
+    int type;
+    uint64_t blockId;
+    double startTime, response;
+    if (::sscanf(line.c_str(), "threadId %u type %d blockId %" SCNu64 " startTime %lf response %lf",
+                 &threadId, &type, &blockId, &startTime, &response) != 5) {
+        return false;
+    }
+    rec.threadId = threadId;
+    rec.type = static_cast<IoType>(type);
+    rec.size = rec.type == IOTYPE_FLUSH ? 0 : blockSize;
+    rec.oft = blockId * blockSize;
+    rec.startTime = startTime;
+    rec.response = response;
+    return true;
+}
+
+/**
+ * @rwbs RWBS field of blkparse.
+ * @return false if it is neither read, write, discard, nor flush.
+ */
+inline bool parseRwbs(const std::string& rwbs, bool hasData, IoType& type)
+{
+    if (!hasData) {
+        if (rwbs.find('F') == std::string::npos) return false;
+        type = IOTYPE_FLUSH;
+    } else if (rwbs.find('D') != std::string::npos) {
+        type = IOTYPE_DISCARD;
+    } else if (rwbs.find('W') != std::string::npos) {
+        type = IOTYPE_WRITE;
+    } else if (rwbs.find('R') != std::string::npos) {
+        type = IOTYPE_READ;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Collect issues (D) and set the response at the matching completion (C).
+ * The thread of an IO is the cpu which issued it.
+ */
+class IssueMatcher
+{
+private:
+    std::vector<TraceRecord>& v_;
+    std::multimap<uint64_t, size_t> pending_; /* offset to index of v_. */
+
+public:
+    explicit IssueMatcher(std::vector<TraceRecord>& v) : v_(v), pending_() {}
+
+    void issue(unsigned int cpu, IoType type, uint64_t oft, size_t size, double time) {
+        TraceRecord rec;
+        rec.threadId = cpu;
+        rec.type = type;
+        rec.oft = oft;
+        rec.size = size;
+        rec.startTime = time;
+        rec.response = -1.0;
+        if (size > 0) pending_.emplace(oft, v_.size());
+        v_.push_back(rec);
+    }
+    /**
+     * Equal keys are kept in order of insertion,
+     * so lower_bound() gives the oldest issue to the sector.
+     */
+    void complete(uint64_t oft, double time) {
+        auto it = pending_.lower_bound(oft);
+        if (it == pending_.end() || it->first != oft) return;
+        TraceRecord& rec = v_[it->second];
+        rec.response = time - rec.startTime;
+        pending_.erase(it);
+    }
+};
+
+/**
+ * Parse the default output of blkparse.
+ * "dev cpu seq time pid action rwbs [sector + nsectors] [process]"
+ */
+inline void parseBlkparse(std::istream& is, std::vector<TraceRecord>& v)
+{
+    IssueMatcher matcher(v);
+    std::string line;
+    while (std::getline(is, line)) {
+        std::istringstream ss(line);
+        std::string dev, action, rwbs, plus;
+        unsigned int cpu, pid;
+        uint64_t seq, sector, nSectors;
+        double time;
+        if (!(ss >> dev >> cpu >> seq >> time >> pid >> action >> rwbs)) continue;
+        if (dev.find(',') == std::string::npos) continue;
+        const bool hasData = static_cast<bool>(ss >> sector >> plus >> nSectors) && plus == "+";
+        if (action == "D") {
+            IoType type;
+            if (!parseRwbs(rwbs, hasData, type)) continue;
+            if (hasData) {
+                matcher.issue(cpu, type, sector * 512, nSectors * 512, time);
+            } else {
+                matcher.issue(cpu, type, 0, 0, time);
+            }
+        } else if (action == "C" && hasData) {
+            matcher.complete(sector * 512, time);
+        }
+    }
+}
+
+/**
+ * Parse binary output of blktrace.
+ * Per-cpu files can be concatenated into one.
+ */
+inline void parseBlktrace(std::istream& is, std::vector<TraceRecord>& v)
+{
+    IssueMatcher matcher(v);
+    struct blk_io_trace t;
+    while (is.read(reinterpret_cast<char *>(&t), sizeof(t))) {
+        if ((t.magic & 0xffffff00) != BLK_IO_TRACE_MAGIC) {
+            throw std::runtime_error("bad magic in blktrace data.");
+        }
+        is.ignore(t.pdu_len);
+        const uint32_t act = t.action & 0xffff;
+        const uint32_t cat = t.action >> BLK_TC_SHIFT;
+        if (cat & BLK_TC_NOTIFY) continue;
+        const double time = static_cast<double>(t.time) / 1000000000.0;
+        if (act == __BLK_TA_ISSUE) {
+            IoType type;
+            if (t.bytes == 0) {
+                if ((cat & BLK_TC_FLUSH) == 0) continue;
+                type = IOTYPE_FLUSH;
+            } else if (cat & BLK_TC_DISCARD) {
+                type = IOTYPE_DISCARD;
+            } else if (cat & BLK_TC_WRITE) {
+                type = IOTYPE_WRITE;
+            } else {
+                type = IOTYPE_READ;
+            }
+            matcher.issue(t.cpu, type, t.sector * 512, t.bytes, time);
+        } else if (act == __BLK_TA_COMPLETE && t.bytes > 0) {
+            matcher.complete(t.sector * 512, time);
+        }
+    }
+}
+
+} // namespace trace_local
+
+/**
+ * Load a trace.
+ * The format is detected from the content:
+ * binary blktrace, output of 'iores -r' (IoLog), or output of blkparse.
+ * IOs of blktrace/blkparse are the issues to the driver (D),
+ * and their responses come from the matching completions (C).
+ *
+ * @blockSize block size of IoLog [byte].
+ */
+inline std::vector<TraceRecord> loadTrace(const std::string& path, size_t blockSize)
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is) {
+        throw std::runtime_error(formatString("could not open %s.", path.c_str()));
+    }
+    std::vector<TraceRecord> v;
+    uint32_t magic = 0;
+    is.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    is.clear();
+    is.seekg(0);
+    if ((magic & 0xffffff00) == BLK_IO_TRACE_MAGIC) {
+        trace_local::parseBlktrace(is, v);
+    } else {
+        std::string line;
+        TraceRecord rec;
+        bool isIoLog = false;
+        while (std::getline(is, line)) {
+            if (trace_local::parseIoLog(line, blockSize, rec)) {
+                isIoLog = true;
+                v.push_back(rec);
+            }
+        }
+        if (!isIoLog) {
+            is.clear();
+            is.seekg(0);
+            trace_local::parseBlkparse(is, v);
+        }
+    }
+    if (v.empty()) {
+        throw std::runtime_error(formatString("no IO found in %s.", path.c_str()));
+    }
+    trace_local::normalize(v);
+    return v;
+}
+
+/**
+ * @return number of threads in a normalized trace.
+ */
+inline size_t getNrTraceThreads(const std::vector<TraceRecord>& v)
+{
+    unsigned int max = 0;
+    for (const TraceRecord& rec : v) max = std::max(max, rec.threadId);
+    return v.empty() ? 0 : max + 1;
+}
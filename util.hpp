@@ -8,6 +8,7 @@
 
 #include <vector>
 #include <queue>
+#include <deque>
 #include <unordered_map>
 #include <map>
 #include <string>
@@ -15,20 +16,38 @@
 #include <exception>
 #include <cerrno>
 #include <cstdio>
+#include <cstring>
+#include <climits>
+#include <cmath>
 #include <stdint.h>
 
 #include <unistd.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
 #include <linux/fs.h>
+#include <linux/falloc.h>
+#include <linux/io_uring.h>
+#include <linux/mempolicy.h>
 #include <libaio.h>
 
-#include "string_util.hpp"
+#ifndef BLOCK_URING_CMD_DISCARD
+#define BLOCK_URING_CMD_DISCARD _IO(0x12, 0) /* since linux 6.12. */
+#endif
 
+#include "string_util.hpp"
+#include "unit_int.hpp"
+#include "rand.hpp"
 
 enum IoType
 {
@@ -85,6 +104,502 @@ enum Mode
     READ_MODE, WRITE_MODE, MIX_MODE, DISCARD_MODE,
 };
 
+/**
+ * IO engines.
+ * SYNC, PVSYNC2, and MMAP are synchronous, used by threads.
+ * LIBAIO and URING are asynchronous.
+ */
+enum IoEngine
+{
+    ENGINE_SYNC, ENGINE_PVSYNC2, ENGINE_MMAP, ENGINE_LIBAIO, ENGINE_URING,
+};
+
+static inline IoEngine parseIoEngine(const std::string& name)
+{
+    if (name == "sync") { return ENGINE_SYNC; }
+    if (name == "pvsync2") { return ENGINE_PVSYNC2; }
+    if (name == "mmap") { return ENGINE_MMAP; }
+    if (name == "aio") { return ENGINE_LIBAIO; }
+    if (name == "uring") { return ENGINE_URING; }
+    throw std::runtime_error(formatString("unknown engine: %s", name.c_str()));
+}
+
+static inline bool isAsyncEngine(IoEngine engine)
+{
+    return engine == ENGINE_LIBAIO || engine == ENGINE_URING;
+}
+
+/**
+ * Parse RWF_* flags for preadv2/pwritev2.
+ * @s comma-separated names: hipri, nowait, dsync, and append.
+ */
+static inline int parseRwFlags(const std::string& s)
+{
+    int flags = 0;
+    for (const std::string& name : splitString(s, ',')) {
+        if (name == "hipri") {
+            flags |= RWF_HIPRI;
+        } else if (name == "nowait") {
+            flags |= RWF_NOWAIT;
+        } else if (name == "dsync") {
+            flags |= RWF_DSYNC;
+        } else if (name == "append") {
+            flags |= RWF_APPEND;
+        } else {
+            throw std::runtime_error(formatString("unknown RWF flag: %s", name.c_str()));
+        }
+    }
+    return flags;
+}
+
+/**
+ * Configuration of the mmap engine.
+ */
+struct MmapConfig
+{
+    bool isPopulate; /* use MAP_POPULATE. */
+    int advice; /* MADV_* for madvise(). negative means not to call it. */
+
+    MmapConfig() : isPopulate(false), advice(-1) {}
+
+    /**
+     * @s comma-separated names: populate, random, sequential, and willneed.
+     */
+    void set(const std::string& s) {
+        for (const std::string& name : splitString(s, ',')) {
+            if (name == "populate") {
+                isPopulate = true;
+            } else if (name == "random") {
+                advice = MADV_RANDOM;
+            } else if (name == "sequential") {
+                advice = MADV_SEQUENTIAL;
+            } else if (name == "willneed") {
+                advice = MADV_WILLNEED;
+            } else {
+                throw std::runtime_error(formatString("unknown mmap option: %s", name.c_str()));
+            }
+        }
+    }
+};
+
+/**
+ * Page cache control for buffered IOs.
+ */
+struct CacheConfig
+{
+    bool isDrop; /* evict pages of the target before the run. */
+    size_t warmPct; /* load the first warmPct% of the access range before the run. */
+    size_t hitUsec; /* a read faster than this [us] is regarded as a page cache hit. */
+
+    CacheConfig() : isDrop(false), warmPct(0), hitUsec(20) {}
+
+    /**
+     * @s comma-separated items: drop, warm=PCT, and hit=USEC.
+     */
+    void set(const std::string& s) {
+        for (const std::string& item : splitString(s, ',')) {
+            if (item == "drop") {
+                isDrop = true;
+            } else if (item.compare(0, 5, "warm=") == 0) {
+                warmPct = ::atol(item.c_str() + 5);
+            } else if (item.compare(0, 4, "hit=") == 0) {
+                hitUsec = ::atol(item.c_str() + 4);
+            } else {
+                throw std::runtime_error(formatString("unknown cache option: %s", item.c_str()));
+            }
+        }
+        if (warmPct > 100) {
+            throw std::runtime_error("warm percentage must be between 0 and 100.");
+        }
+    }
+};
+
+/**
+ * Kinds of IOs to release or zero a range.
+ */
+enum TrimKind
+{
+    TRIM_DISCARD, /* discard a range of a block device like BLKDISCARD. */
+    TRIM_ZEROOUT, /* fallocate(ZERO_RANGE), which is BLKZEROOUT for block devices. */
+    TRIM_PUNCH, /* fallocate(PUNCH_HOLE). */
+};
+
+/**
+ * Trim IOs mixed into the other IOs.
+ */
+struct TrimConfig
+{
+    TrimKind kind;
+    size_t pct; /* percentage of trim IOs. 0 means no trim IO. */
+
+    TrimConfig() : kind(TRIM_DISCARD), pct(0) {}
+
+    bool isEnabled() const { return pct > 0; }
+
+    /**
+     * @s "kind[,pct]". kind is discard, zeroout, or punch. pct is 100 by default.
+     */
+    void set(const std::string& s) {
+        std::vector<std::string> v = splitString(s, ',');
+        if (v.empty() || v.size() > 2) {
+            throw std::runtime_error("specify trim parameters as kind[,pct].");
+        }
+        if (v[0] == "discard") {
+            kind = TRIM_DISCARD;
+        } else if (v[0] == "zeroout") {
+            kind = TRIM_ZEROOUT;
+        } else if (v[0] == "punch") {
+            kind = TRIM_PUNCH;
+        } else {
+            throw std::runtime_error(formatString("unknown trim kind: %s", v[0].c_str()));
+        }
+        pct = v.size() == 2 ? ::atol(v[1].c_str()) : 100;
+        if (pct == 0 || pct > 100) {
+            throw std::runtime_error("trim percentage must be between 1 and 100.");
+        }
+    }
+};
+
+/**
+ * Weighted distribution of IO sizes (bssplit), or a single IO size.
+ */
+struct BsSplitConfig
+{
+    std::vector<size_t> sizes; /* [byte] in ascending order. */
+    std::vector<size_t> weights;
+    size_t totalWeight;
+
+    BsSplitConfig() : sizes(), weights(), totalWeight(0) {}
+
+    /**
+     * @s "size" or "size:weight,size:weight,...".
+     *   Each size must be a multiple of the smallest one.
+     */
+    void set(const std::string& s) {
+        std::vector<std::pair<size_t, size_t> > v;
+        for (const std::string& item : splitString(s, ',')) {
+            std::vector<std::string> sw = splitString(item, ':');
+            if (sw.empty() || sw.size() > 2) {
+                throw std::runtime_error(formatString("bad block size: %s", item.c_str()));
+            }
+            const size_t weight = sw.size() == 2 ? ::atol(sw[1].c_str()) : 1;
+            v.push_back(std::make_pair(fromUnitIntString(sw[0]), weight));
+        }
+        std::sort(v.begin(), v.end());
+        sizes.clear();
+        weights.clear();
+        totalWeight = 0;
+        for (const auto& p : v) {
+            if (p.first == 0 || p.second == 0) {
+                throw std::runtime_error("block sizes and their weights must not be 0.");
+            }
+            if (!sizes.empty() && (p.first == sizes.back() || p.first % sizes.front() != 0)) {
+                throw std::runtime_error("block sizes must be distinct multiples of the smallest one.");
+            }
+            sizes.push_back(p.first);
+            weights.push_back(p.second);
+            totalWeight += p.second;
+        }
+    }
+
+    bool isSplit() const { return sizes.size() > 1; }
+    size_t getNr() const { return sizes.size(); }
+    size_t getMin() const { return sizes.front(); }
+    size_t getMax() const { return sizes.back(); }
+
+    /**
+     * @return index of an IO size.
+     */
+    size_t getIndex(size_t size) const {
+        for (size_t i = 0; i < sizes.size(); i++) {
+            if (sizes[i] == size) return i;
+        }
+        assert(false);
+        return 0;
+    }
+
+    /**
+     * Choose an IO size by the weights.
+     */
+    size_t pick(Xoshiro256& rand) const {
+        if (!isSplit()) return sizes[0];
+        uint64_t x = rand.get(totalWeight);
+        size_t i = 0;
+        while (x >= weights[i]) {
+            x -= weights[i];
+            i++;
+        }
+        return sizes[i];
+    }
+
+    /**
+     * Get the offset of an IO aligned to its size.
+     * @blockId [block] where a block is the smallest size.
+     * @size IO size [byte].
+     * @accessRange [block]. It must contain the largest size.
+     * @return offset [byte].
+     */
+    uint64_t getOffset(uint64_t blockId, size_t size, uint64_t accessRange) const {
+        const uint64_t bs = getMin();
+        const uint64_t oft = blockId * bs / size * size;
+        const uint64_t maxOft = (accessRange * bs - size) / size * size;
+        return std::min(oft, maxOft);
+    }
+};
+
+enum PlacementType
+{
+    PLACE_STRIPE, PLACE_HASH, PLACE_THREAD,
+};
+
+/**
+ * Placement of IOs on multiple targets.
+ */
+struct PlacementConfig
+{
+    PlacementType type;
+    size_t chunkSize; /* [byte]. 0 means the default. */
+
+    PlacementConfig() : type(PLACE_STRIPE), chunkSize(0) {}
+
+    /**
+     * @s "stripe[,chunk]", "hash[,chunk]", or "thread".
+     */
+    void set(const std::string& s) {
+        std::vector<std::string> v = splitString(s, ',');
+        if (v.empty() || v.size() > 2 || (v[0] == "thread" && v.size() == 2)) {
+            throw std::runtime_error("specify placement as stripe[,chunk], hash[,chunk], or thread.");
+        }
+        if (v[0] == "stripe") {
+            type = PLACE_STRIPE;
+        } else if (v[0] == "hash") {
+            type = PLACE_HASH;
+        } else if (v[0] == "thread") {
+            type = PLACE_THREAD;
+        } else {
+            throw std::runtime_error(formatString("bad placement: %s", v[0].c_str()));
+        }
+        chunkSize = v.size() == 2 ? fromUnitIntString(v[1]) : 0;
+    }
+
+    /**
+     * Decide the chunk size for IO sizes.
+     * Each IO must fit in a chunk, so the chunk must be a multiple of all the sizes.
+     * The default is the smallest such multiple of at least 64KiB.
+     */
+    void setChunkSize(const BsSplitConfig& bsSplit) {
+        size_t lcm = 1;
+        for (size_t size : bsSplit.sizes) {
+            size_t a = lcm, b = size;
+            while (b != 0) { const size_t t = a % b; a = b; b = t; }
+            lcm = lcm / a * size;
+        }
+        if (chunkSize == 0) {
+            const size_t min = 64 << 10;
+            chunkSize = (min + lcm - 1) / lcm * lcm;
+        } else if (chunkSize % lcm != 0) {
+            throw std::runtime_error("chunk size must be a multiple of all the block sizes.");
+        }
+    }
+};
+
+/**
+ * Cap of IOs or bytes per second.
+ */
+struct RateConfig
+{
+    double rate; /* 0 means no cap. */
+    bool isPerThread; /* each thread has the rate, or the threads share it. */
+
+    RateConfig() : rate(0), isPerThread(false) {}
+
+    /**
+     * @s "rate[,thread]".
+     */
+    void set(const std::string& s) {
+        std::vector<std::string> v = splitString(s, ',');
+        if (v.empty() || v.size() > 2 || (v.size() == 2 && v[1] != "thread")) {
+            throw std::runtime_error(formatString("bad rate: %s", s.c_str()));
+        }
+        rate = static_cast<double>(fromUnitIntString(v[0]));
+        isPerThread = v.size() == 2;
+        if (rate <= 0) {
+            throw std::runtime_error("rate must be positive.");
+        }
+    }
+
+    bool isEnabled() const { return rate > 0; }
+
+    /**
+     * @nthreads number of threads sharing the rate. 0 is regarded as 1.
+     * @return rate of a thread.
+     */
+    double getThreadRate(size_t nthreads) const {
+        if (isPerThread || nthreads <= 1) return rate;
+        return rate / nthreads;
+    }
+};
+
+/**
+ * Wait until the time of getTime().
+ * This sleeps until shortly before it and spins for the rest,
+ * because sleeps overshoot by tens of microseconds.
+ */
+static inline void waitUntil(double t)
+{
+    const double spin = 0.0001; /* [sec] */
+    double now = getTime();
+    if (t - now > spin) {
+        const double wake = t - spin;
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(wake);
+        ts.tv_nsec = static_cast<long>((wake - ts.tv_sec) * 1000000000.0);
+        while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+    }
+    while (getTime() < t);
+}
+
+/**
+ * Token bucket to cap a rate.
+ * Tokens accumulate at the rate up to the burst.
+ * acquire() takes tokens in advance and waits until the debt is paid,
+ * so each IO is paced individually instead of in bursts per interval.
+ */
+class TokenBucket
+{
+private:
+    double rate_; /* [token/sec]. 0 means no cap. */
+    double burst_;
+    double tokens_;
+    double last_; /* [sec] */
+
+public:
+    /**
+     * @burst maximum tokens saved while idle.
+     */
+    TokenBucket(double rate, double burst)
+        : rate_(rate), burst_(burst), tokens_(burst), last_(getTime()) {}
+
+    bool isEnabled() const { return rate_ > 0; }
+
+    void acquire(double n) {
+        if (rate_ <= 0) return;
+        const double now = getTime();
+        tokens_ = std::min(burst_, tokens_ + (now - last_) * rate_);
+        last_ = now;
+        tokens_ -= n;
+        if (tokens_ < 0) {
+            waitUntil(now - tokens_ / rate_);
+        }
+    }
+};
+
+/**
+ * IOPS and bandwidth caps of a thread.
+ */
+class Throttle
+{
+private:
+    TokenBucket iops_;
+    TokenBucket bps_;
+
+public:
+    /**
+     * Each bucket saves tokens for at most 1ms or one IO.
+     * @iopsCfg cap of IOs.
+     * @bpsCfg cap of bytes.
+     * @nthreads number of threads sharing the caps.
+     * @maxIoSize [byte]
+     */
+    Throttle(const RateConfig& iopsCfg, const RateConfig& bpsCfg, size_t nthreads, size_t maxIoSize)
+        : iops_(makeBucket(iopsCfg.getThreadRate(nthreads), 1))
+        , bps_(makeBucket(bpsCfg.getThreadRate(nthreads), maxIoSize)) {}
+
+    Throttle() : Throttle(RateConfig(), RateConfig(), 1, 0) {}
+
+    bool isEnabled() const { return iops_.isEnabled() || bps_.isEnabled(); }
+
+    /**
+     * Wait until an IO can be issued.
+     * @size [byte]. 0 for IOs without data.
+     */
+    void acquire(size_t size) {
+        iops_.acquire(1);
+        if (size > 0) bps_.acquire(static_cast<double>(size));
+    }
+
+private:
+    static TokenBucket makeBucket(double rate, double minBurst) {
+        return TokenBucket(rate, std::max(rate * 0.001, minBurst));
+    }
+};
+
+/**
+ * Split of each IO into iovecs.
+ */
+struct VectorConfig
+{
+    size_t nrSegs; /* number of iovecs per IO. 0 means not to use vectored IO. */
+    std::vector<size_t> sizes; /* sizes of the iovecs. empty when isRandom. */
+    bool isRandom; /* split at random 512-byte aligned points for each IO. */
+
+    VectorConfig() : nrSegs(0), sizes(), isRandom(false) {}
+
+    bool isEnabled() const { return nrSegs > 0; }
+
+    /**
+     * @s "num" to split into num equal iovecs,
+     *    "rand,num" to split into num iovecs of random sizes for each IO, or
+     *    "size,size,..." to split into iovecs of the sizes.
+     */
+    void set(const std::string& s) {
+        std::vector<std::string> v = splitString(s, ',');
+        sizes.clear();
+        isRandom = false;
+        if (v.size() == 1) {
+            nrSegs = fromUnitIntString(v[0]);
+        } else if (v.size() == 2 && v[0] == "rand") {
+            isRandom = true;
+            nrSegs = fromUnitIntString(v[1]);
+        } else {
+            for (const std::string& size : v) {
+                sizes.push_back(fromUnitIntString(size));
+            }
+            nrSegs = sizes.size();
+        }
+        if (nrSegs == 0 || nrSegs > IOV_MAX) {
+            throw std::runtime_error(formatString("number of iovecs must be between 1 and %d.", IOV_MAX));
+        }
+    }
+
+    /**
+     * Validate the split against the block size and fix equal sizes.
+     */
+    void setBlockSize(size_t blockSize) {
+        if (!isEnabled()) { return; }
+        if (nrSegs > blockSize / 512) {
+            throw std::runtime_error("each iovec must be 512 bytes or more.");
+        }
+        if (isRandom) { return; }
+        if (sizes.empty()) {
+            if (blockSize % (nrSegs * 512) != 0) {
+                throw std::runtime_error("block size must be split into equal iovecs of multiples of 512.");
+            }
+            sizes.assign(nrSegs, blockSize / nrSegs);
+        }
+        size_t total = 0;
+        for (size_t size : sizes) {
+            if (size == 0 || size % 512 != 0) {
+                throw std::runtime_error("iovec sizes must be multiples of 512.");
+            }
+            total += size;
+        }
+        if (total != blockSize) {
+            throw std::runtime_error("sum of iovec sizes must be the block size.");
+        }
+    }
+};
+
 class BlockDevice
 {
 private:
@@ -92,13 +607,21 @@ private:
     Mode mode_;
     int fd_;
     size_t deviceSize_;
+    bool isPositional_; /* use preadv2/pwritev2. */
+    int rwFlags_; /* RWF_* flags for preadv2/pwritev2. */
+    size_t nrAgain_; /* number of IOs returned EAGAIN due to RWF_NOWAIT. */
+    char *map_; /* non-null when IOs are served from the mapping. */
 
 public:
     BlockDevice(const std::string& name, const Mode mode, bool isDirect)
         : name_(name)
         , mode_(mode)
         , fd_(openDevice(name, mode, isDirect))
-        , deviceSize_(getDeviceSizeFirst()) {
+        , deviceSize_(getDeviceSizeFirst())
+        , isPositional_(false)
+        , rwFlags_(0)
+        , nrAgain_(0)
+        , map_(nullptr) {
 #if 0
         ::printf("device %s size %zu mode %d isDirect %d\n",
                  name_.c_str(), size_, mode_, isDirect_);
@@ -108,21 +631,37 @@ public:
         : name_(std::move(rhs.name_))
         , mode_(rhs.mode_)
         , fd_(rhs.fd_)
-        , deviceSize_(rhs.deviceSize_) {
+        , deviceSize_(rhs.deviceSize_)
+        , isPositional_(rhs.isPositional_)
+        , rwFlags_(rhs.rwFlags_)
+        , nrAgain_(rhs.nrAgain_)
+        , map_(rhs.map_) {
 
         rhs.fd_ = -1;
+        rhs.map_ = nullptr;
     }
     BlockDevice& operator=(BlockDevice&& rhs) {
 
+        if (map_ && map_ != rhs.map_) {
+            ::munmap(map_, deviceSize_);
+        }
         name_ = std::move(rhs.name_);
         mode_ = rhs.mode_;
         fd_ = rhs.fd_; rhs.fd_ = -1;
         deviceSize_= rhs.deviceSize_;
+        isPositional_ = rhs.isPositional_;
+        rwFlags_ = rhs.rwFlags_;
+        nrAgain_ = rhs.nrAgain_;
+        map_ = rhs.map_; rhs.map_ = nullptr;
         return *this;
     }
 
     ~BlockDevice() {
 
+        if (map_) {
+            ::munmap(map_, deviceSize_);
+            map_ = nullptr;
+        }
         if (fd_ > 0) {
             ::close(fd_);
             fd_ = -1;
@@ -139,12 +678,72 @@ public:
 
     class EofError : public std::exception {};
 
+    /**
+     * Issue IOs by preadv2/pwritev2 with RWF_* flags
+     * instead of lseek and read/write.
+     * An IO returned EAGAIN due to RWF_NOWAIT is counted
+     * and retried without RWF_NOWAIT.
+     */
+    void setPositional(int rwFlags) {
+
+        isPositional_ = true;
+        rwFlags_ = rwFlags;
+    }
+
+    /**
+     * Map the whole device and serve IOs by memcpy() from/to the mapping.
+     * flush() will call msync().
+     */
+    void setMmap(const MmapConfig& cfg) {
+
+        if (mode_ == WRITE_MODE) {
+            /* A shared writable mapping requires the file opened for reading also. */
+            int fd = ::open(name_.c_str(), O_RDWR | (::fcntl(fd_, F_GETFL) & O_DIRECT));
+            if (fd < 0) {
+                std::string e("open failed: ");
+                e += ::strerror(errno);
+                throw std::runtime_error(e);
+            }
+            ::close(fd_);
+            fd_ = fd;
+        }
+        int prot = PROT_READ;
+        if (mode_ != READ_MODE) { prot |= PROT_WRITE; }
+        int flags = MAP_SHARED;
+        if (cfg.isPopulate) { flags |= MAP_POPULATE; }
+        void *p = ::mmap(NULL, deviceSize_, prot, flags, fd_, 0);
+        if (p == MAP_FAILED) {
+            std::string e("mmap failed: ");
+            e += ::strerror(errno);
+            throw std::runtime_error(e);
+        }
+        map_ = static_cast<char *>(p);
+        if (cfg.advice >= 0 && ::madvise(map_, deviceSize_, cfg.advice) != 0) {
+            std::string e("madvise failed: ");
+            e += ::strerror(errno);
+            throw std::runtime_error(e);
+        }
+    }
+
+    /**
+     * Get number of IOs returned EAGAIN due to RWF_NOWAIT.
+     */
+    size_t getNrAgain() const { return nrAgain_; }
+
     /**
      * Read data and fill a buffer.
      */
     void read(off_t oft, size_t size, char* buf) {
 
         if (deviceSize_ < oft + size) { throw EofError(); }
+        if (map_) {
+            ::memcpy(buf, map_ + oft, size);
+            return;
+        }
+        if (isPositional_) {
+            rwPositional(false, oft, size, buf);
+            return;
+        }
         ::lseek(fd_, oft, SEEK_SET);
         size_t s = 0;
         while (s < size) {
@@ -165,6 +764,14 @@ public:
 
         if (deviceSize_ < oft + size) { throw EofError(); }
         if (mode_ == READ_MODE) { throw std::runtime_error("write is not permitted."); }
+        if (map_) {
+            ::memcpy(map_ + oft, buf, size);
+            return;
+        }
+        if (isPositional_) {
+            rwPositional(true, oft, size, buf);
+            return;
+        }
         ::lseek(fd_, oft, SEEK_SET);
         size_t s = 0;
         while (s < size) {
@@ -178,12 +785,31 @@ public:
         }
     }
 
+    /**
+     * Read data into iovecs by preadv2.
+     * RWF_* flags are used if setPositional() has been called.
+     */
+    void readv(off_t oft, const struct iovec *iov, int iovcnt) {
+
+        rwVectored(false, oft, iov, iovcnt);
+    }
+
+    /**
+     * Write data of iovecs by pwritev2.
+     * RWF_* flags are used if setPositional() has been called.
+     */
+    void writev(off_t oft, const struct iovec *iov, int iovcnt) {
+
+        if (mode_ == READ_MODE) { throw std::runtime_error("write is not permitted."); }
+        rwVectored(true, oft, iov, iovcnt);
+    }
+
     /**
      * Flush written data.
      */
     void flush() {
 
-        int ret = ::fdatasync(fd_);
+        int ret = map_ ? ::msync(map_, deviceSize_, MS_SYNC) : ::fdatasync(fd_);
         if (ret) {
             std::string e("flush failed: ");
             e += ::strerror(errno);
@@ -218,21 +844,94 @@ public:
 private:
 
     /**
-     * Helper function for constructor.
+     * Read or write with preadv2/pwritev2.
      */
-    int openDevice(const std::string& name, Mode mode, bool isDirect) {
-
-        int fd;
-        int flags = 0;
-        switch (mode) {
-        case READ_MODE:    flags = O_RDONLY; break;
-        case WRITE_MODE:   flags = O_WRONLY; break;
-        case MIX_MODE:     flags = O_RDWR;   break;
-        case DISCARD_MODE: flags = O_RDWR;   break;
-        }
-        if (isDirect) { flags |= O_DIRECT; }
+    void rwPositional(bool isWrite, off_t oft, size_t size, char* buf) {
 
-        fd = ::open(name.c_str(), flags);
+        int flags = rwFlags_;
+        size_t s = 0;
+        while (s < size) {
+            struct iovec iov;
+            iov.iov_base = &buf[s];
+            iov.iov_len = size - s;
+            ssize_t ret = isWrite ?
+                ::pwritev2(fd_, &iov, 1, oft + s, flags) :
+                ::preadv2(fd_, &iov, 1, oft + s, flags);
+            if (ret < 0) {
+                if (errno == EAGAIN && (flags & RWF_NOWAIT)) {
+                    nrAgain_++;
+                    flags &= ~RWF_NOWAIT;
+                    continue;
+                }
+                std::string e(isWrite ? "pwritev2 failed: " : "preadv2 failed: ");
+                e += ::strerror(errno);
+                throw std::runtime_error(e);
+            }
+            if (ret == 0) { throw EofError(); }
+            s += ret;
+        }
+    }
+
+    void rwVectored(bool isWrite, off_t oft, const struct iovec *iov, int iovcnt) {
+
+        assert(!map_);
+        size_t size = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            size += iov[i].iov_len;
+        }
+        if (deviceSize_ < oft + size) { throw EofError(); }
+
+        int flags = isPositional_ ? rwFlags_ : 0;
+        std::vector<struct iovec> rest; /* remaining iovecs after a short IO. */
+        size_t s = 0;
+        while (s < size) {
+            ssize_t ret = isWrite ?
+                ::pwritev2(fd_, iov, iovcnt, oft + s, flags) :
+                ::preadv2(fd_, iov, iovcnt, oft + s, flags);
+            if (ret < 0) {
+                if (errno == EAGAIN && (flags & RWF_NOWAIT)) {
+                    nrAgain_++;
+                    flags &= ~RWF_NOWAIT;
+                    continue;
+                }
+                std::string e(isWrite ? "pwritev2 failed: " : "preadv2 failed: ");
+                e += ::strerror(errno);
+                throw std::runtime_error(e);
+            }
+            if (ret == 0) { throw EofError(); }
+            s += ret;
+            if (s == size) { break; }
+            rest.assign(iov, iov + iovcnt);
+            size_t i = 0;
+            size_t r = ret;
+            while (r >= rest[i].iov_len) {
+                r -= rest[i].iov_len;
+                i++;
+            }
+            rest[i].iov_base = static_cast<char *>(rest[i].iov_base) + r;
+            rest[i].iov_len -= r;
+            rest.erase(rest.begin(), rest.begin() + i);
+            iov = &rest[0];
+            iovcnt = rest.size();
+        }
+    }
+
+    /**
+     * Helper function for constructor.
+     */
+    int openDevice(const std::string& name, Mode mode, bool isDirect) {
+
+        int fd;
+        int flags = 0;
+        switch (mode) {
+        case READ_MODE:    flags = O_RDONLY; break;
+        case WRITE_MODE:   flags = O_WRONLY; break;
+        case MIX_MODE:     flags = O_RDWR;   break;
+        case DISCARD_MODE: flags = O_RDWR;   break;
+        }
+        if (isDirect) { flags |= O_DIRECT; }
+
+        fd = ::open(name.c_str(), flags);
         if (fd < 0) {
             std::stringstream ss;
             ss << "open failed: " << name
@@ -273,6 +972,158 @@ private:
     }
 };
 
+/**
+ * Targets of IOs seen as one address space.
+ * stripe places chunks on the targets in turn.
+ * hash places each row of chunks, one chunk per target, in the order
+ * rotated by a hash of the row, which is still one-to-one.
+ * thread opens only the target of the thread.
+ * IOs must not cross chunks (see fit()).
+ */
+class TargetSet
+{
+private:
+    std::vector<BlockDevice> devs_;
+    std::vector<size_t> ids_; /* index of each device in the names. */
+    PlacementConfig cfg_;
+    uint64_t nrChunks_; /* used chunks of each device. */
+    size_t lastIdx_; /* device of the last IO. */
+
+public:
+    /**
+     * @names all the targets.
+     * @cfg its chunk size must be set if there are multiple targets.
+     * @threadId the target of thread placement is threadId modulo the number of names.
+     */
+    TargetSet(const std::vector<std::string>& names, Mode mode, bool isDirect,
+              const PlacementConfig& cfg, size_t threadId)
+        : devs_()
+        , ids_()
+        , cfg_(cfg)
+        , nrChunks_(0)
+        , lastIdx_(0) {
+
+        assert(!names.empty());
+        if (cfg.type == PLACE_THREAD || names.size() == 1) {
+            ids_.push_back(threadId % names.size());
+        } else {
+            for (size_t i = 0; i < names.size(); i++) ids_.push_back(i);
+        }
+        devs_.reserve(ids_.size());
+        uint64_t minSize = UINT64_MAX;
+        for (size_t id : ids_) {
+            devs_.emplace_back(names[id], mode, isDirect);
+            minSize = std::min<uint64_t>(minSize, devs_.back().getDeviceSize());
+        }
+        if (devs_.size() > 1) {
+            assert(cfg_.chunkSize > 0);
+            nrChunks_ = minSize / cfg_.chunkSize;
+        }
+    }
+
+    size_t getNr() const { return devs_.size(); }
+    BlockDevice& getDevice(size_t idx) { return devs_[idx]; }
+    const BlockDevice& getDevice(size_t idx) const { return devs_[idx]; }
+    Mode getMode() const { return devs_[0].getMode(); }
+
+    /**
+     * @idx index of an opened device.
+     * @return index of the device in the names.
+     */
+    size_t getId(size_t idx) const { return ids_[idx]; }
+
+    /**
+     * @return index in the names of the target of the last IO.
+     */
+    size_t getLastId() const { return ids_[lastIdx_]; }
+
+    std::vector<int> getFds() const {
+        std::vector<int> v;
+        for (const BlockDevice& dev : devs_) v.push_back(dev.getFd());
+        return v;
+    }
+
+    /**
+     * Get size of the address space [byte].
+     */
+    size_t getDeviceSize() const {
+        if (devs_.size() == 1) return devs_[0].getDeviceSize();
+        return nrChunks_ * cfg_.chunkSize * devs_.size();
+    }
+
+    /**
+     * @oft offset in the address space [byte].
+     * @return index of the device and offset in it [byte].
+     */
+    std::pair<size_t, uint64_t> locate(uint64_t oft) const {
+        const size_t n = devs_.size();
+        if (n == 1) return std::make_pair(0, oft);
+        const uint64_t chunk = cfg_.chunkSize;
+        const uint64_t chunkId = oft / chunk;
+        const uint64_t row = chunkId / n;
+        uint64_t idx = chunkId % n;
+        if (cfg_.type == PLACE_HASH) idx = (idx + mix(row) % n) % n;
+        return std::make_pair(idx, row * chunk + oft % chunk);
+    }
+
+    /**
+     * @return oft, or the start of the next chunk if the IO crosses chunks.
+     */
+    uint64_t fit(uint64_t oft, size_t size) const {
+        if (devs_.size() == 1) return oft;
+        const uint64_t chunk = cfg_.chunkSize;
+        if (oft / chunk == (oft + size - 1) / chunk) return oft;
+        return (oft / chunk + 1) * chunk;
+    }
+
+    void setPositional(int rwFlags) {
+        for (BlockDevice& dev : devs_) dev.setPositional(rwFlags);
+    }
+    void setMmap(const MmapConfig& cfg) {
+        for (BlockDevice& dev : devs_) dev.setMmap(cfg);
+    }
+    size_t getNrAgain() const {
+        size_t nr = 0;
+        for (const BlockDevice& dev : devs_) nr += dev.getNrAgain();
+        return nr;
+    }
+
+    void read(off_t oft, size_t size, char* buf) { select(oft).read(oft, size, buf); }
+    void write(off_t oft, size_t size, char* buf) { select(oft).write(oft, size, buf); }
+    void readv(off_t oft, const struct iovec *iov, int iovcnt) {
+        select(oft).readv(oft, iov, iovcnt);
+    }
+    void writev(off_t oft, const struct iovec *iov, int iovcnt) {
+        select(oft).writev(oft, iov, iovcnt);
+    }
+    void discard(off_t oft, size_t size) { select(oft).discard(oft, size); }
+
+    /**
+     * Flush all the targets.
+     */
+    void flush() {
+        for (BlockDevice& dev : devs_) dev.flush();
+    }
+
+private:
+    /**
+     * Choose the device of an IO and convert the offset into it.
+     */
+    BlockDevice& select(off_t& oft) {
+        const std::pair<size_t, uint64_t> loc = locate(oft);
+        lastIdx_ = loc.first;
+        oft = loc.second;
+        return devs_[loc.first];
+    }
+
+    static uint64_t mix(uint64_t x) {
+        /* finalizer of splitmix64. */
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+};
+
 /**
  * Calculate access range.
  */
@@ -282,6 +1133,79 @@ static inline size_t calcAccessRange(
     return (accessRange == 0) ? (dev.getDeviceSize() / blockSize) : accessRange;
 }
 
+/**
+ * Calculate access range in the address space of targets.
+ */
+static inline size_t calcAccessRange(
+    size_t accessRange, size_t blockSize, const TargetSet& targets) {
+
+    return (accessRange == 0) ? (targets.getDeviceSize() / blockSize) : accessRange;
+}
+
+/**
+ * Write back and evict cached pages of a device.
+ */
+static inline void dropPageCache(const BlockDevice& dev)
+{
+    if (::fdatasync(dev.getFd()) != 0) {
+        throw std::runtime_error(formatString("fdatasync failed: %s", ::strerror(errno)));
+    }
+    int err = ::posix_fadvise(dev.getFd(), 0, 0, POSIX_FADV_DONTNEED);
+    if (err != 0) {
+        throw std::runtime_error(formatString("posix_fadvise failed: %s", ::strerror(err)));
+    }
+}
+
+/**
+ * Load the beginning of a device into page cache by buffered reads.
+ * @size [byte]
+ */
+static inline void warmPageCache(const BlockDevice& dev, size_t size)
+{
+    const size_t chunk = 1 << 20;
+    std::vector<char> buf(chunk);
+    size_t oft = 0;
+    while (oft < size) {
+        ssize_t r = ::pread(dev.getFd(), &buf[0], std::min(chunk, size - oft), oft);
+        if (r < 0) {
+            throw std::runtime_error(formatString("pread failed: %s", ::strerror(errno)));
+        }
+        if (r == 0) break;
+        oft += r;
+    }
+}
+
+/**
+ * Count pages of the beginning of a device resident in page cache.
+ * @size [byte]
+ * @return a pair of resident pages and total pages.
+ */
+static inline std::pair<size_t, size_t> countResidentPages(const BlockDevice& dev, size_t size)
+{
+    const size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    const size_t chunk = 1 << 30; /* map a part at a time to limit address space. */
+    std::vector<unsigned char> vec;
+    size_t resident = 0, total = 0;
+    for (size_t oft = 0; oft < size; oft += chunk) {
+        const size_t len = std::min(chunk, size - oft);
+        void *p = ::mmap(NULL, len, PROT_READ, MAP_SHARED, dev.getFd(), oft);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error(formatString("mmap failed: %s", ::strerror(errno)));
+        }
+        vec.resize((len + pageSize - 1) / pageSize);
+        int r = ::mincore(p, len, &vec[0]);
+        ::munmap(p, len);
+        if (r != 0) {
+            throw std::runtime_error(formatString("mincore failed: %s", ::strerror(errno)));
+        }
+        for (unsigned char c : vec) {
+            if (c & 1) resident++;
+        }
+        total += vec.size();
+    }
+    return std::make_pair(resident, total);
+}
+
 /**
  * An aio data.
  */
@@ -294,6 +1218,8 @@ struct AioData
     char *buf;
     double beginTime;
     double endTime;
+    double scheduledTime; /* intended issue time in open-loop runs. 0 means beginTime. */
+    size_t fileIdx; /* index of the target file given to Aio or IoUring. */
 };
 
 /**
@@ -302,36 +1228,149 @@ struct AioData
 typedef std::shared_ptr<AioData> AioDataPtr;
 
 /**
- * Asynchronous IO wrapper.
+ * Configuration of asynchronous IO engines.
  */
-class Aio
+struct AsyncIoConfig
 {
-private:
-    int fd_;
-    size_t queueSize_;
-    io_context_t ctx_;
-    std::queue<AioData *> aioQueue_;
+    int sqpollIdleMs; /* io_uring SQPOLL idle period [ms]. negative means no SQPOLL. */
+    int sqpollCpu; /* CPU to pin the SQPOLL thread. negative means no pinning. */
+    bool isUserReap; /* libaio: reap completions from the ring in user space. */
 
-    class AioDataBuffer
-    {
-    private:
-        const size_t size_;
-        size_t idx_;
-        std::vector<AioData> aioVec_;
+    AsyncIoConfig() : sqpollIdleMs(-1), sqpollCpu(-1), isUserReap(false) {}
+
+    bool isSqpoll() const { return sqpollIdleMs >= 0; }
+
+    /**
+     * @s "idle[,cpu]".
+     */
+    void setSqpoll(const std::string& s) {
+        std::vector<std::string> v = splitString(s, ',');
+        if (v.empty() || v.size() > 2) {
+            throw std::runtime_error("specify SQPOLL parameters as idle[,cpu].");
+        }
+        sqpollIdleMs = ::atoi(v[0].c_str());
+        sqpollCpu = v.size() == 2 ? ::atoi(v[1].c_str()) : -1;
+        if (sqpollIdleMs < 0) {
+            throw std::runtime_error("SQPOLL idle period must not be negative.");
+        }
+    }
+};
+
+/**
+ * Arrivals of IOs in open-loop runs.
+ */
+struct ArrivalConfig
+{
+    double rate; /* [IO/sec]. 0 means closed-loop. */
+    bool isPoisson;
+
+    ArrivalConfig() : rate(0), isPoisson(false) {}
+
+    /**
+     * @s "rate[,fixed|poisson]".
+     */
+    void set(const std::string& s) {
+        std::vector<std::string> v = splitString(s, ',');
+        if (v.empty() || v.size() > 2) {
+            throw std::runtime_error("specify arrivals as rate[,fixed|poisson].");
+        }
+        rate = ::atof(v[0].c_str());
+        if (rate <= 0) {
+            throw std::runtime_error("arrival rate must be positive.");
+        }
+        isPoisson = false;
+        if (v.size() == 2) {
+            if (v[1] == "poisson") {
+                isPoisson = true;
+            } else if (v[1] != "fixed") {
+                throw std::runtime_error(formatString("bad arrival process: %s", v[1].c_str()));
+            }
+        }
+    }
+
+    bool isEnabled() const { return rate > 0; }
+
+    /**
+     * Mean interval between arrivals [sec].
+     */
+    double getInterval() const { return 1.0 / rate; }
+
+    /**
+     * @return interval to the next arrival [sec].
+     */
+    double next(Xoshiro256& rand) const {
+        if (!isPoisson) return getInterval();
+        return -std::log(1.0 - rand.getDouble()) / rate;
+    }
+};
 
-    public:
-        AioDataBuffer(size_t size)
-            : size_(size)
-            , idx_(0)
-            , aioVec_(size) {}
+/**
+ * Pool of AioData shared by asynchronous IO engines.
+ * A data is reused only after it has been released at its completion,
+ * so a slow IO never has its data overwritten.
+ * Released data are reused in FIFO order, so a completed data stays valid
+ * while at least (size - queue size) other IOs are prepared.
+ */
+class AioDataBuffer
+{
+private:
+    std::vector<AioData> aioVec_;
+    std::deque<AioData *> freeQ_;
 
-        AioData* next() {
+public:
+    AioDataBuffer(size_t size)
+        : aioVec_(size)
+        , freeQ_() {
 
-            AioData *ret = &aioVec_[idx_];
-            idx_ = (idx_ + 1) % size_;
-            return ret;
+        for (AioData& data : aioVec_) {
+            freeQ_.push_back(&data);
         }
+    }
+
+    AioData* next() {
+
+        assert(!freeQ_.empty());
+        AioData *ret = freeQ_.front();
+        freeQ_.pop_front();
+        ret->scheduledTime = 0.0;
+        return ret;
+    }
+
+    void release(AioData *ptr) {
+
+        freeQ_.push_back(ptr);
+    }
+};
+
+/**
+ * Asynchronous IO wrapper.
+ */
+class Aio
+{
+private:
+    /**
+     * Header of the completion ring which the kernel maps
+     * to the address of io_context_t (struct aio_ring in fs/aio.c).
+     */
+    struct AioRing
+    {
+        unsigned id;
+        unsigned nr; /* number of io_events. */
+        unsigned head; /* written by user space or the kernel. */
+        unsigned tail; /* written by the kernel. */
+        unsigned magic;
+        unsigned compatFeatures;
+        unsigned incompatFeatures;
+        unsigned headerLength;
     };
+    static const unsigned AIO_RING_MAGIC = 0xa10a10a1;
+
+    std::vector<int> fds_;
+    size_t fileIdx_; /* file of the IOs to be prepared. */
+    size_t queueSize_;
+    io_context_t ctx_;
+    AioRing *ring_; /* non-null if completions are reaped in user space. */
+    std::queue<AioData *> aioQueue_;
 
     AioDataBuffer aioDataBuf_;
     std::vector<struct iocb *> iocbs_; /* temporal use for submit. */
@@ -341,16 +1380,33 @@ public:
     /**
      * @fd Opened file descripter.
      * @queueSize queue size for aio.
+     * @cfg engine configuration.
+     */
+    Aio(int fd, size_t queueSize, const AsyncIoConfig& cfg = AsyncIoConfig())
+        : Aio(std::vector<int>(1, fd), queueSize, cfg) {}
+
+    /**
+     * @fds Opened file descripters. IOs go to the one chosen by selectFile().
      */
-    Aio(int fd, size_t queueSize)
-        : fd_(fd)
+    Aio(const std::vector<int>& fds, size_t queueSize, const AsyncIoConfig& cfg = AsyncIoConfig())
+        : fds_(fds)
+        , fileIdx_(0)
         , queueSize_(queueSize)
+        , ring_(nullptr)
         , aioDataBuf_(queueSize * 2)
         , iocbs_(queueSize)
         , ioEvents_(queueSize) {
 
-        assert(fd_ > 0);
+        assert(!fds_.empty());
         ::io_queue_init(queueSize_, &ctx_);
+        if (cfg.isUserReap) {
+            ring_ = reinterpret_cast<AioRing *>(ctx_);
+            if (ring_ == nullptr || ring_->magic != AIO_RING_MAGIC ||
+                ring_->incompatFeatures != 0) {
+                ::io_queue_release(ctx_);
+                throw std::runtime_error("aio completion ring is not available in user space.");
+            }
+        }
     }
 
     ~Aio() noexcept {
@@ -360,6 +1416,22 @@ public:
 
     class EofError : public std::exception {};
 
+    /**
+     * libaio has no notion of registered buffers.
+     * This exists to share the interface with IoUring.
+     */
+    void registerBuffers(const std::vector<struct iovec>&) {}
+
+    /**
+     * Choose the file of IOs prepared after this.
+     * @idx index in the file descripters given to the constructor.
+     */
+    void selectFile(size_t idx) {
+
+        assert(idx < fds_.size());
+        fileIdx_ = idx;
+    }
+
     /**
      * Prepare a read IO.
      */
@@ -377,7 +1449,8 @@ public:
         ptr->buf = buf;
         ptr->beginTime = 0.0;
         ptr->endTime = 0.0;
-        ::io_prep_pread(&ptr->iocb, fd_, buf, size, oft);
+        ptr->fileIdx = fileIdx_;
+        ::io_prep_pread(&ptr->iocb, fds_[fileIdx_], buf, size, oft);
         ptr->iocb.data = ptr;
         return true;
     }
@@ -399,11 +1472,30 @@ public:
         ptr->buf = buf;
         ptr->beginTime = 0.0;
         ptr->endTime = 0.0;
-        ::io_prep_pwrite(&ptr->iocb, fd_, buf, size, oft);
+        ptr->fileIdx = fileIdx_;
+        ::io_prep_pwrite(&ptr->iocb, fds_[fileIdx_], buf, size, oft);
         ptr->iocb.data = ptr;
         return true;
     }
 
+    /**
+     * Prepare a read IO into iovecs.
+     * The iovecs must be kept until the IO completes.
+     */
+    bool prepareReadv(off_t oft, const struct iovec *iov, int iovcnt) noexcept {
+
+        return prepareRwv(IOTYPE_READ, oft, iov, iovcnt);
+    }
+
+    /**
+     * Prepare a write IO of iovecs.
+     * The iovecs must be kept until the IO completes.
+     */
+    bool prepareWritev(off_t oft, const struct iovec *iov, int iovcnt) noexcept {
+
+        return prepareRwv(IOTYPE_WRITE, oft, iov, iovcnt);
+    }
+
     /**
      * Prepare a flush IO.
      */
@@ -416,11 +1508,21 @@ public:
         ptr->buf = NULL;
         ptr->beginTime = 0.0;
         ptr->endTime = 0.0;
-        ::io_prep_fdsync(&ptr->iocb, fd_);
+        ptr->fileIdx = fileIdx_;
+        ::io_prep_fdsync(&ptr->iocb, fds_[fileIdx_]);
         ptr->iocb.data = ptr;
         return true;
     }
 
+    /**
+     * libaio has no command to discard or zero a range.
+     * This exists to share the interface with IoUring.
+     */
+    bool prepareTrim(TrimKind, off_t, size_t) {
+
+        throw std::runtime_error("trim IOs are not supported by libaio.");
+    }
+
     /**
      * Submit all prepared IO(s).
      */
@@ -446,6 +1548,15 @@ public:
         }
     }
 
+    /**
+     * Set the intended issue time of the last prepared IO.
+     */
+    void setScheduledTime(double t) {
+
+        assert(!aioQueue_.empty());
+        aioQueue_.back()->scheduledTime = t;
+    }
+
     /**
      * Wait several IO(s) completed.
      *
@@ -466,11 +1577,12 @@ public:
             for (size_t i = done; i < done + tmpNr; i++) {
                 auto* iocb = static_cast<struct iocb *>(ioEvents_[i].obj);
                 auto* ptr = static_cast<AioData *>(iocb->data);
-                if (ioEvents_[i].res != ptr->iocb.u.c.nbytes) {
+                if (ioEvents_[i].res != ptr->size) {
                     isError = true;
                 }
                 ptr->endTime = endTime;
                 aioDataQueue.push(*ptr);
+                aioDataBuf_.release(ptr);
             }
             done += tmpNr;
         }
@@ -490,28 +1602,635 @@ public:
     AioData* waitOne() {
 
         auto& event = ioEvents_[0];
-        int err = ::io_getevents(ctx_, 1, 1, &event, NULL);
-        double endTime = getTime();
-        if (err != 1) {
-            throw std::runtime_error("io_getevents failed.");
+        if (!reapFromRing(event)) {
+            int err = ::io_getevents(ctx_, 1, 1, &event, NULL);
+            if (err != 1) {
+                throw std::runtime_error("io_getevents failed.");
+            }
         }
+        double endTime = getTime();
         auto* iocb = static_cast<struct iocb *>(event.obj);
         auto* ptr = static_cast<AioData *>(iocb->data);
-        if (event.res != ptr->iocb.u.c.nbytes) {
+        aioDataBuf_.release(ptr);
+        if (event.res != ptr->size) {
             // ::printf("waitOne error %lu\n", event.res);
             throw EofError();
         }
         ptr->endTime = endTime;
         return ptr;
     }
-};
 
+    /**
+     * Wait at least one and at most maxNr IO(s) completed.
+     *
+     * @maxNr maximum number of IOs to reap. It must be <= queue size.
+     * @aioVec completed IOs will be set.
+     * @timeout [sec]. negative means to wait without timeout.
+     * @return number of completed IOs. 0 means timeout.
+     */
+    size_t waitSome(size_t maxNr, std::vector<AioData *>& aioVec, double timeout = -1.0) {
+
+        assert(0 < maxNr && maxNr <= ioEvents_.size());
+        size_t nr = 0;
+        while (nr < maxNr && reapFromRing(ioEvents_[nr])) {
+            nr++;
+        }
+        if (nr == 0) {
+            struct timespec ts;
+            if (timeout >= 0) {
+                ts.tv_sec = static_cast<time_t>(timeout);
+                ts.tv_nsec = static_cast<long>((timeout - ts.tv_sec) * 1000000000.0);
+            }
+            int err;
+            do {
+                err = ::io_getevents(ctx_, 1, maxNr, &ioEvents_[0], timeout >= 0 ? &ts : NULL);
+            } while (err == -EINTR);
+            if (err < 0 || (err == 0 && timeout < 0)) {
+                throw std::runtime_error("io_getevents failed.");
+            }
+            if (err == 0) {
+                aioVec.clear();
+                return 0;
+            }
+            nr = err;
+        }
+        double endTime = getTime();
+        bool isError = false;
+        aioVec.clear();
+        for (size_t i = 0; i < nr; i++) {
+            auto* iocb = static_cast<struct iocb *>(ioEvents_[i].obj);
+            auto* ptr = static_cast<AioData *>(iocb->data);
+            aioDataBuf_.release(ptr);
+            if (ioEvents_[i].res != ptr->size) {
+                isError = true;
+            }
+            ptr->endTime = endTime;
+            aioVec.push_back(ptr);
+        }
+        if (isError) {
+            throw EofError();
+        }
+        return nr;
+    }
 
-class PerformanceStatistics
-{
 private:
-    double total_;
-    double max_;
+    bool prepareRwv(IoType type, off_t oft, const struct iovec *iov, int iovcnt) noexcept {
+
+        if (aioQueue_.size() > queueSize_) {
+            return false;
+        }
+
+        auto* ptr = aioDataBuf_.next();
+        aioQueue_.push(ptr);
+        ptr->type = type;
+        ptr->oft = oft;
+        ptr->size = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            ptr->size += iov[i].iov_len;
+        }
+        ptr->buf = NULL;
+        ptr->beginTime = 0.0;
+        ptr->endTime = 0.0;
+        ptr->fileIdx = fileIdx_;
+        if (type == IOTYPE_WRITE) {
+            ::io_prep_pwritev(&ptr->iocb, fds_[fileIdx_], iov, iovcnt, oft);
+        } else {
+            ::io_prep_preadv(&ptr->iocb, fds_[fileIdx_], iov, iovcnt, oft);
+        }
+        ptr->iocb.data = ptr;
+        return true;
+    }
+
+    /**
+     * Take a completion event from the ring without a system call.
+     * @return false if user space reaping is disabled or the ring is empty.
+     */
+    bool reapFromRing(struct io_event& event) noexcept {
+
+        if (!ring_) { return false; }
+        const unsigned head = ring_->head;
+        if (head == __atomic_load_n(&ring_->tail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        const struct io_event *events = reinterpret_cast<const struct io_event *>(
+            reinterpret_cast<const char *>(ring_) + sizeof(AioRing));
+        event = events[head];
+        __atomic_store_n(&ring_->head, (head + 1) % ring_->nr, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+/**
+ * io_uring wrapper with the same interface as Aio.
+ *
+ * This uses raw system calls so it does not require liburing.
+ * The target file is registered and IOs on registered buffers
+ * (see registerBuffers()) are issued as READ_FIXED/WRITE_FIXED.
+ */
+class IoUring
+{
+private:
+    std::vector<int> fds_;
+    size_t fileIdx_; /* file of the IOs to be prepared. */
+    size_t queueSize_;
+    int ringFd_;
+    struct io_uring_params params_;
+
+    void *sqRing_;
+    size_t sqRingSize_;
+    void *cqRing_;
+    size_t cqRingSize_;
+    void *sqes_;
+    size_t sqesSize_;
+
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned sqMask_;
+    unsigned *sqArray_;
+    unsigned *sqFlags_;
+    unsigned sqLocalTail_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe *cqes_;
+
+    std::queue<AioData *> aioQueue_;
+    AioDataBuffer aioDataBuf_;
+    std::unordered_map<const char *, unsigned> bufIdx_; /* registered buffers. */
+
+public:
+    /**
+     * @fd Opened file descripter.
+     * @queueSize queue size for io_uring.
+     * @cfg engine configuration.
+     */
+    IoUring(int fd, size_t queueSize, const AsyncIoConfig& cfg = AsyncIoConfig())
+        : IoUring(std::vector<int>(1, fd), queueSize, cfg) {}
+
+    /**
+     * @fds Opened file descripters, which are all registered.
+     *   IOs go to the one chosen by selectFile().
+     */
+    IoUring(const std::vector<int>& fds, size_t queueSize,
+            const AsyncIoConfig& cfg = AsyncIoConfig())
+        : fds_(fds)
+        , fileIdx_(0)
+        , queueSize_(queueSize)
+        , ringFd_(-1)
+        , params_()
+        , sqRing_(MAP_FAILED), sqRingSize_(0)
+        , cqRing_(MAP_FAILED), cqRingSize_(0)
+        , sqes_(MAP_FAILED), sqesSize_(0)
+        , sqHead_(nullptr), sqTail_(nullptr), sqMask_(0)
+        , sqArray_(nullptr), sqFlags_(nullptr), sqLocalTail_(0)
+        , cqHead_(nullptr), cqTail_(nullptr), cqMask_(0)
+        , cqes_(nullptr)
+        , aioQueue_()
+        , aioDataBuf_(queueSize * 2)
+        , bufIdx_() {
+
+        assert(!fds_.empty());
+        if (cfg.isSqpoll()) {
+            params_.flags |= IORING_SETUP_SQPOLL;
+            params_.sq_thread_idle = cfg.sqpollIdleMs;
+            if (cfg.sqpollCpu >= 0) {
+                params_.flags |= IORING_SETUP_SQ_AFF;
+                params_.sq_thread_cpu = cfg.sqpollCpu;
+            }
+        }
+        ringFd_ = ::syscall(__NR_io_uring_setup, queueSize_, &params_);
+        if (ringFd_ < 0) {
+            throw std::runtime_error(
+                formatString("io_uring_setup failed: %s", ::strerror(errno)));
+        }
+        try {
+            mapRings();
+            if (::syscall(__NR_io_uring_register, ringFd_,
+                          IORING_REGISTER_FILES, &fds_[0], fds_.size()) < 0) {
+                throw std::runtime_error(
+                    formatString("register files failed: %s", ::strerror(errno)));
+            }
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    ~IoUring() noexcept {
+
+        release();
+    }
+
+    class EofError : public std::exception {};
+
+    /**
+     * Register buffers to issue fixed buffer IOs.
+     * IOs on other buffers are issued as normal ones.
+     */
+    void registerBuffers(const std::vector<struct iovec>& iovs) {
+
+        if (::syscall(__NR_io_uring_register, ringFd_,
+                      IORING_REGISTER_BUFFERS, &iovs[0], iovs.size()) < 0) {
+            throw std::runtime_error(
+                formatString("register buffers failed: %s", ::strerror(errno)));
+        }
+        for (size_t i = 0; i < iovs.size(); i++) {
+            bufIdx_[static_cast<const char *>(iovs[i].iov_base)] = i;
+        }
+    }
+
+    /**
+     * Choose the file of IOs prepared after this.
+     * @idx index in the file descripters given to the constructor.
+     */
+    void selectFile(size_t idx) {
+
+        assert(idx < fds_.size());
+        fileIdx_ = idx;
+    }
+
+    /**
+     * Prepare a read IO.
+     */
+    bool prepareRead(off_t oft, size_t size, char* buf) noexcept {
+
+        return prepareRw(IOTYPE_READ, oft, size, buf);
+    }
+
+    /**
+     * Prepare a write IO.
+     */
+    bool prepareWrite(off_t oft, size_t size, char* buf) noexcept {
+
+        return prepareRw(IOTYPE_WRITE, oft, size, buf);
+    }
+
+    /**
+     * Prepare a read IO into iovecs.
+     * The iovecs must be kept until the IO completes.
+     */
+    bool prepareReadv(off_t oft, const struct iovec *iov, int iovcnt) noexcept {
+
+        return prepareRwv(IOTYPE_READ, oft, iov, iovcnt);
+    }
+
+    /**
+     * Prepare a write IO of iovecs.
+     * The iovecs must be kept until the IO completes.
+     */
+    bool prepareWritev(off_t oft, const struct iovec *iov, int iovcnt) noexcept {
+
+        return prepareRwv(IOTYPE_WRITE, oft, iov, iovcnt);
+    }
+
+    /**
+     * Prepare a flush IO.
+     */
+    bool prepareFlush() noexcept {
+
+        struct io_uring_sqe *sqe = getSqe(IOTYPE_FLUSH, 0, 0, NULL);
+        if (!sqe) { return false; }
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        return true;
+    }
+
+    /**
+     * Prepare a trim IO, which completes as IOTYPE_DISCARD.
+     * Discard of block devices requires linux 6.12 or later.
+     */
+    bool prepareTrim(TrimKind kind, off_t oft, size_t size) noexcept {
+
+        struct io_uring_sqe *sqe = getSqe(IOTYPE_DISCARD, oft, size, NULL);
+        if (!sqe) { return false; }
+        switch (kind) {
+        case TRIM_DISCARD:
+            sqe->opcode = IORING_OP_URING_CMD;
+            sqe->cmd_op = BLOCK_URING_CMD_DISCARD;
+            sqe->addr = oft;
+            sqe->addr3 = size;
+            break;
+        case TRIM_ZEROOUT:
+            sqe->opcode = IORING_OP_FALLOCATE;
+            sqe->off = oft;
+            sqe->addr = size;
+            sqe->len = FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE;
+            break;
+        case TRIM_PUNCH:
+            sqe->opcode = IORING_OP_FALLOCATE;
+            sqe->off = oft;
+            sqe->addr = size;
+            sqe->len = FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+            break;
+        }
+        return true;
+    }
+
+    /**
+     * Submit all prepared IO(s).
+     */
+    void submit() {
+
+        size_t nr = aioQueue_.size();
+        if (nr == 0) {
+            return;
+        }
+        double beginTime = getTime();
+        while (!aioQueue_.empty()) {
+            aioQueue_.front()->beginTime = beginTime;
+            aioQueue_.pop();
+        }
+        __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+        if (isSqpoll()) {
+            /*
+             * The kernel thread consumes the entries by itself.
+             * Enter the kernel only to wake it up after it has slept.
+             */
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (__atomic_load_n(sqFlags_, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+                enter(0, 0, IORING_ENTER_SQ_WAKEUP);
+            }
+            return;
+        }
+        int err = enter(nr, 0, 0);
+        if (err != static_cast<int>(nr)) {
+            throw EofError();
+        }
+    }
+
+    /**
+     * Set the intended issue time of the last prepared IO.
+     */
+    void setScheduledTime(double t) {
+
+        assert(!aioQueue_.empty());
+        aioQueue_.back()->scheduledTime = t;
+    }
+
+    /**
+     * Wait just one IO completed.
+     *
+     * @return aio data pointer.
+     *   This data is available at least before calling
+     *   queueSize_ times of prepareWrite/prepareRead.
+     */
+    AioData* waitOne() {
+
+        const unsigned head = *cqHead_;
+        while (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+            enter(0, 1, IORING_ENTER_GETEVENTS);
+        }
+        double endTime = getTime();
+        const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+        auto* ptr = reinterpret_cast<AioData *>(cqe.user_data);
+        const int res = cqe.res;
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        aioDataBuf_.release(ptr);
+        checkResult(ptr, res);
+        ptr->endTime = endTime;
+        return ptr;
+    }
+
+    /**
+     * Wait at least one and at most maxNr IO(s) completed.
+     *
+     * @maxNr maximum number of IOs to reap.
+     * @aioVec completed IOs will be set.
+     * @timeout [sec]. negative means to wait without timeout.
+     * @return number of completed IOs. 0 means timeout.
+     */
+    size_t waitSome(size_t maxNr, std::vector<AioData *>& aioVec, double timeout = -1.0) {
+
+        assert(maxNr > 0);
+        const double deadline = getTime() + timeout;
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        while (head == tail) {
+            if (timeout < 0) {
+                enter(0, 1, IORING_ENTER_GETEVENTS);
+            } else if (!enterUntil(deadline)) {
+                aioVec.clear();
+                return 0;
+            }
+            tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        }
+        double endTime = getTime();
+        AioData *errPtr = nullptr;
+        int errRes = 0;
+        aioVec.clear();
+        while (head != tail && aioVec.size() < maxNr) {
+            const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+            auto* ptr = reinterpret_cast<AioData *>(cqe.user_data);
+            aioDataBuf_.release(ptr);
+            if (!errPtr && !isSucceeded(ptr, cqe.res)) {
+                errPtr = ptr;
+                errRes = cqe.res;
+            }
+            ptr->endTime = endTime;
+            aioVec.push_back(ptr);
+            head++;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        if (errPtr) {
+            checkResult(errPtr, errRes);
+        }
+        return aioVec.size();
+    }
+
+private:
+    bool isSqpoll() const { return (params_.flags & IORING_SETUP_SQPOLL) != 0; }
+
+    /**
+     * @res result in the cqe. Reads and writes return the size,
+     *   and the others return 0 on success.
+     */
+    static bool isSucceeded(const AioData *ptr, int res) {
+
+        const bool hasData = ptr->type == IOTYPE_READ || ptr->type == IOTYPE_WRITE;
+        return res >= 0 && static_cast<size_t>(res) == (hasData ? ptr->size : 0);
+    }
+
+    static void checkResult(const AioData *ptr, int res) {
+
+        if (isSucceeded(ptr, res)) { return; }
+        if (ptr->type == IOTYPE_DISCARD && res < 0) {
+            throw std::runtime_error(formatString("trim failed: %s", ::strerror(-res)));
+        }
+        throw EofError();
+    }
+
+    void mapRings() {
+
+        sqRingSize_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params_.cq_off.cqes +
+            params_.cq_entries * sizeof(struct io_uring_cqe);
+        const bool isSingleMmap = (params_.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (isSingleMmap) {
+            sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+            cqRingSize_ = sqRingSize_;
+        }
+        sqRing_ = mapRegion(sqRingSize_, IORING_OFF_SQ_RING);
+        cqRing_ = isSingleMmap ? sqRing_ : mapRegion(cqRingSize_, IORING_OFF_CQ_RING);
+        sqesSize_ = params_.sq_entries * sizeof(struct io_uring_sqe);
+        sqes_ = mapRegion(sqesSize_, IORING_OFF_SQES);
+
+        char *sq = static_cast<char *>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned *>(sq + params_.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned *>(sq + params_.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned *>(sq + params_.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned *>(sq + params_.sq_off.array);
+        sqFlags_ = reinterpret_cast<unsigned *>(sq + params_.sq_off.flags);
+        sqLocalTail_ = *sqTail_;
+        char *cq = static_cast<char *>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned *>(cq + params_.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned *>(cq + params_.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned *>(cq + params_.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params_.cq_off.cqes);
+    }
+
+    void *mapRegion(size_t size, off_t oft) {
+
+        void *p = ::mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ringFd_, oft);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error(
+                formatString("mmap io_uring failed: %s", ::strerror(errno)));
+        }
+        return p;
+    }
+
+    void release() noexcept {
+
+        if (sqes_ != MAP_FAILED) { ::munmap(sqes_, sqesSize_); }
+        if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+            ::munmap(cqRing_, cqRingSize_);
+        }
+        if (sqRing_ != MAP_FAILED) { ::munmap(sqRing_, sqRingSize_); }
+        sqes_ = MAP_FAILED;
+        cqRing_ = MAP_FAILED;
+        sqRing_ = MAP_FAILED;
+        if (ringFd_ >= 0) {
+            ::close(ringFd_);
+            ringFd_ = -1;
+        }
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+
+        int ret;
+        do {
+            ret = ::syscall(__NR_io_uring_enter, ringFd_, toSubmit,
+                            minComplete, flags, NULL, 0);
+        } while (ret < 0 && errno == EINTR);
+        if (ret < 0) {
+            throw std::runtime_error(
+                formatString("io_uring_enter failed: %s", ::strerror(errno)));
+        }
+        return ret;
+    }
+
+    /**
+     * Wait for a completion until deadline.
+     * Without IORING_FEAT_EXT_ARG, this returns immediately
+     * and the caller polls the ring until the deadline.
+     * @return false if the deadline has passed.
+     */
+    bool enterUntil(double deadline) {
+
+        const double remaining = deadline - getTime();
+        if (remaining <= 0) {
+            return false;
+        }
+        if ((params_.features & IORING_FEAT_EXT_ARG) == 0) {
+            return true;
+        }
+        struct __kernel_timespec ts;
+        ts.tv_sec = static_cast<int64_t>(remaining);
+        ts.tv_nsec = static_cast<long long>((remaining - ts.tv_sec) * 1000000000.0);
+        struct io_uring_getevents_arg arg;
+        ::memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        int ret = ::syscall(__NR_io_uring_enter, ringFd_, 0, 1,
+                            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        if (ret < 0 && errno != ETIME && errno != EINTR) {
+            throw std::runtime_error(
+                formatString("io_uring_enter failed: %s", ::strerror(errno)));
+        }
+        return true;
+    }
+
+    /**
+     * Get a cleared sqe and bind a new AioData to it.
+     * @return NULL if the submission queue is full.
+     */
+    struct io_uring_sqe *getSqe(IoType type, off_t oft, size_t size, char *buf) noexcept {
+
+        if (aioQueue_.size() >= queueSize_ ||
+            sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE)
+            >= params_.sq_entries) {
+            return NULL;
+        }
+        const unsigned idx = sqLocalTail_ & sqMask_;
+        struct io_uring_sqe *sqe = &static_cast<struct io_uring_sqe *>(sqes_)[idx];
+        ::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[idx] = idx;
+        sqLocalTail_++;
+
+        auto* ptr = aioDataBuf_.next();
+        aioQueue_.push(ptr);
+        ptr->type = type;
+        ptr->oft = oft;
+        ptr->size = size;
+        ptr->buf = buf;
+        ptr->beginTime = 0.0;
+        ptr->endTime = 0.0;
+        ptr->fileIdx = fileIdx_;
+
+        sqe->fd = fileIdx_; /* index in the registered files. */
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->user_data = reinterpret_cast<uint64_t>(ptr);
+        return sqe;
+    }
+
+    bool prepareRw(IoType type, off_t oft, size_t size, char *buf) noexcept {
+
+        struct io_uring_sqe *sqe = getSqe(type, oft, size, buf);
+        if (!sqe) { return false; }
+        const bool isWrite = (type == IOTYPE_WRITE);
+        auto it = bufIdx_.find(buf);
+        if (it != bufIdx_.end()) {
+            sqe->opcode = isWrite ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->buf_index = it->second;
+        } else {
+            sqe->opcode = isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+        }
+        sqe->off = oft;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = size;
+        return true;
+    }
+
+    bool prepareRwv(IoType type, off_t oft, const struct iovec *iov, int iovcnt) noexcept {
+
+        size_t size = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            size += iov[i].iov_len;
+        }
+        struct io_uring_sqe *sqe = getSqe(type, oft, size, NULL);
+        if (!sqe) { return false; }
+        sqe->opcode = type == IOTYPE_WRITE ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->off = oft;
+        sqe->addr = reinterpret_cast<uint64_t>(iov);
+        sqe->len = iovcnt;
+        return true;
+    }
+};
+
+class PerformanceStatistics
+{
+private:
+    double total_;
+    double max_;
     double min_;
     size_t count_;
 
@@ -564,6 +2283,7 @@ static inline PerformanceStatistics mergeStats(const T begin, const T end)
 
     std::for_each(begin, end, [&](PerformanceStatistics& stat) {
 
+            if (stat.getCount() == 0) { return; }
             total += stat.getTotal();
             if (max < 0 || max < stat.getMax()) { max = stat.getMax(); }
             if (min < 0 || min > stat.getMin()) { min = stat.getMin(); }
@@ -602,19 +2322,365 @@ std::string getDataThroughputString(double throughput)
 
 /**
  * Print throughput data.
- * @blockSize block size [bytes].
+ * @bytes total size of the IOs [bytes].
  * @nio Number of IO executed.
  * @periodInSec Elapsed time [second].
  */
 static inline
-void printThroughput(size_t blockSize, size_t nio, double periodInSec)
+void printDataThroughput(uint64_t bytes, size_t nio, double periodInSec)
 {
-    double throughput = static_cast<double>(blockSize * nio) / periodInSec;
+    double throughput = static_cast<double>(bytes) / periodInSec;
     double iops = static_cast<double>(nio) / periodInSec;
     ::printf("Throughput: %.3f B/s %s %.3f iops.\n",
              throughput, getDataThroughputString(throughput).c_str(), iops);
 }
 
+/**
+ * Print throughput data.
+ * @blockSize block size [bytes].
+ * @nio Number of IO executed.
+ * @periodInSec Elapsed time [second].
+ */
+static inline
+void printThroughput(size_t blockSize, size_t nio, double periodInSec)
+{
+    printDataThroughput(blockSize * nio, nio, periodInSec);
+}
+
+/**
+ * Statistics of IOs to each target.
+ */
+class TargetStatistics
+{
+private:
+    std::vector<PerformanceStatistics> stats_;
+    std::vector<uint64_t> bytes_;
+
+public:
+    /**
+     * @nr number of the targets.
+     */
+    explicit TargetStatistics(size_t nr = 0) : stats_(nr), bytes_(nr, 0) {}
+
+    bool isEnabled() const { return !stats_.empty(); }
+
+    void add(size_t id, size_t size, double rt) {
+        stats_[id].updateRt(rt);
+        bytes_[id] += size;
+    }
+
+    void merge(const TargetStatistics& rhs) {
+        if (stats_.empty()) {
+            *this = rhs;
+            return;
+        }
+        for (size_t i = 0; i < rhs.stats_.size(); i++) {
+            PerformanceStatistics v[] = {stats_[i], rhs.stats_[i]};
+            stats_[i] = mergeStats(v, v + 2);
+            bytes_[i] += rhs.bytes_[i];
+        }
+    }
+
+    /**
+     * Print statistics and throughput of each target.
+     * @names the targets.
+     * @periodInSec Elapsed time [second].
+     */
+    void print(const std::vector<std::string>& names, double periodInSec) const {
+        for (size_t i = 0; i < stats_.size(); i++) {
+            ::printf("target %s ", names[i].c_str());
+            stats_[i].print();
+            ::printf("target %s ", names[i].c_str());
+            printDataThroughput(bytes_[i], stats_[i].getCount(), periodInSec);
+        }
+    }
+};
+
+/**
+ * Distribution of the number of IOs handled by each
+ * submission or completion call.
+ */
+class BatchStatistics
+{
+private:
+    std::vector<size_t> counts_; /* index is batch size. */
+    size_t nrCalls_;
+    size_t nrIos_;
+
+public:
+    explicit BatchStatistics(size_t maxBatch = 0)
+        : counts_(maxBatch + 1), nrCalls_(0), nrIos_(0) {}
+
+    void add(size_t nr) {
+
+        if (nr >= counts_.size()) { counts_.resize(nr + 1); }
+        counts_[nr]++;
+        nrCalls_++;
+        nrIos_ += nr;
+    }
+
+    /**
+     * @name label of the line.
+     */
+    void print(const char *name) const {
+
+        const double avg = nrCalls_ == 0 ? 0.0 :
+            static_cast<double>(nrIos_) / static_cast<double>(nrCalls_);
+        ::printf("%s: calls %zu ios %zu avg %.02f sizes", name, nrCalls_, nrIos_, avg);
+        for (size_t i = 0; i < counts_.size(); i++) {
+            if (counts_[i] > 0) { ::printf(" %zu:%zu", i, counts_[i]); }
+        }
+        ::printf("\n");
+    }
+};
+
+/**
+ * CPU time consumed by a thread [second].
+ */
+struct CpuTime
+{
+    double user;
+    double sys;
+
+    CpuTime() : user(0), sys(0) {}
+
+    /**
+     * Get CPU time of the calling thread.
+     */
+    static CpuTime getThread() {
+        struct rusage ru;
+        if (::getrusage(RUSAGE_THREAD, &ru) != 0) {
+            throw std::runtime_error(formatString("getrusage failed: %s", ::strerror(errno)));
+        }
+        CpuTime t;
+        t.user = static_cast<double>(ru.ru_utime.tv_sec) +
+            static_cast<double>(ru.ru_utime.tv_usec) / 1000000.0;
+        t.sys = static_cast<double>(ru.ru_stime.tv_sec) +
+            static_cast<double>(ru.ru_stime.tv_usec) / 1000000.0;
+        return t;
+    }
+};
+
+/**
+ * Page faults occurred in a thread.
+ */
+struct FaultCount
+{
+    size_t major;
+    size_t minor;
+
+    FaultCount() : major(0), minor(0) {}
+
+    /**
+     * Get page fault counts of the calling thread.
+     */
+    static FaultCount getThread() {
+        struct rusage ru;
+        if (::getrusage(RUSAGE_THREAD, &ru) != 0) {
+            throw std::runtime_error(formatString("getrusage failed: %s", ::strerror(errno)));
+        }
+        FaultCount f;
+        f.major = ru.ru_majflt;
+        f.minor = ru.ru_minflt;
+        return f;
+    }
+};
+
+namespace affinity_local {
+
+/**
+ * @return cpus which the process is allowed to run on.
+ */
+static inline std::vector<int> getAllowedCpus()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) != 0) {
+        throw std::runtime_error(formatString("sched_getaffinity failed: %s", ::strerror(errno)));
+    }
+    std::vector<int> v;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) v.push_back(cpu);
+    }
+    return v;
+}
+
+/**
+ * @return NUMA node of a cpu. 0 without NUMA information.
+ */
+static inline int getNodeOfCpu(int cpu)
+{
+    const std::string path = formatString("/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = ::opendir(path.c_str());
+    if (dir == nullptr) return 0;
+    int node = 0;
+    struct dirent *ent;
+    while ((ent = ::readdir(dir)) != nullptr) {
+        if (::sscanf(ent->d_name, "node%d", &node) == 1) break;
+    }
+    ::closedir(dir);
+    return node;
+}
+
+/**
+ * @s cpu list like "0-3,8".
+ */
+static inline std::vector<int> parseCpuList(const std::string& s)
+{
+    std::vector<int> v;
+    for (const std::string& range : splitString(s, ',')) {
+        int bgn, end;
+        char c;
+        if (::sscanf(range.c_str(), "%d-%d%c", &bgn, &end, &c) == 2) {
+            /* range. */
+        } else if (::sscanf(range.c_str(), "%d%c", &bgn, &c) == 1) {
+            end = bgn;
+        } else {
+            throw std::runtime_error(formatString("bad cpu list: %s", s.c_str()));
+        }
+        if (bgn < 0 || end < bgn || end >= CPU_SETSIZE) {
+            throw std::runtime_error(formatString("bad cpu list: %s", s.c_str()));
+        }
+        for (int cpu = bgn; cpu <= end; cpu++) v.push_back(cpu);
+    }
+    return v;
+}
+
+} // namespace affinity_local
+
+enum AffinityType
+{
+    AFFINITY_NONE, AFFINITY_LIST, AFFINITY_COMPACT, AFFINITY_SCATTER,
+};
+
+/**
+ * Placement of worker threads on cpus and of their memory on NUMA nodes.
+ * Thread i runs on cpus[i % the cpus].
+ */
+struct AffinityConfig
+{
+    AffinityType type;
+    bool isNumaBind; /* bind memory of each thread to the node of its cpu. */
+    std::vector<int> cpus;
+    std::vector<int> nodes; /* node of each of cpus. */
+
+    AffinityConfig() : type(AFFINITY_NONE), isNumaBind(false), cpus(), nodes() {}
+
+    /**
+     * @s "compact", "scatter", or a cpu list like "0-3,8".
+     *   compact fills the allowed cpus of a node before the next node,
+     *   and scatter takes the nodes in turn.
+     */
+    void set(const std::string& s) {
+        const std::vector<int> allowed = affinity_local::getAllowedCpus();
+        std::map<int, std::vector<int> > nodeCpus;
+        for (int cpu : allowed) nodeCpus[affinity_local::getNodeOfCpu(cpu)].push_back(cpu);
+        cpus.clear();
+        if (s == "compact") {
+            type = AFFINITY_COMPACT;
+            for (const auto& p : nodeCpus) {
+                cpus.insert(cpus.end(), p.second.begin(), p.second.end());
+            }
+        } else if (s == "scatter") {
+            type = AFFINITY_SCATTER;
+            for (size_t i = 0; cpus.size() < allowed.size(); i++) {
+                for (const auto& p : nodeCpus) {
+                    if (i < p.second.size()) cpus.push_back(p.second[i]);
+                }
+            }
+        } else {
+            type = AFFINITY_LIST;
+            cpus = affinity_local::parseCpuList(s);
+            for (int cpu : cpus) {
+                if (std::find(allowed.begin(), allowed.end(), cpu) == allowed.end()) {
+                    throw std::runtime_error(formatString("cpu %d is not available.", cpu));
+                }
+            }
+        }
+        if (cpus.empty()) {
+            throw std::runtime_error(formatString("no cpu for affinity: %s", s.c_str()));
+        }
+        nodes.clear();
+        for (int cpu : cpus) nodes.push_back(affinity_local::getNodeOfCpu(cpu));
+    }
+
+    bool isEnabled() const { return type != AFFINITY_NONE; }
+    int getCpu(size_t threadId) const { return cpus[threadId % cpus.size()]; }
+    int getNode(size_t threadId) const { return nodes[threadId % nodes.size()]; }
+
+    /**
+     * Pin the calling thread as the thread threadId,
+     * and bind memory it allocates from now on with -N.
+     */
+    void place(size_t threadId) const {
+        if (!isEnabled()) return;
+        const int cpu = getCpu(threadId);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        const int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            throw std::runtime_error(formatString("could not pin to cpu %d: %s", cpu, ::strerror(err)));
+        }
+        bindMemory(threadId);
+    }
+
+    /**
+     * Bind memory which the calling thread allocates from now on
+     * to the node of the thread threadId.
+     * This lets another thread prepare buffers for the thread.
+     */
+    void bindMemory(size_t threadId) const {
+        if (!isEnabled() || !isNumaBind) return;
+        const int node = getNode(threadId);
+        const size_t bits = sizeof(unsigned long) * CHAR_BIT;
+        std::vector<unsigned long> mask(node / bits + 1, 0);
+        mask[node / bits] |= 1UL << (node % bits);
+        /* the kernel regards maxnode as the number of bits plus one. */
+        if (::syscall(SYS_set_mempolicy, MPOL_BIND, mask.data(), mask.size() * bits + 1) != 0) {
+            throw std::runtime_error(formatString("could not bind memory to node %d: %s",
+                                                  node, ::strerror(errno)));
+        }
+    }
+
+    /**
+     * Allocate memory of the calling thread as usual again.
+     */
+    void unbindMemory() const {
+        if (!isEnabled() || !isNumaBind) return;
+        if (::syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0) != 0) {
+            throw std::runtime_error(formatString("set_mempolicy failed: %s", ::strerror(errno)));
+        }
+    }
+
+    /**
+     * Print where each of nr threads runs.
+     * @label of thread ids as the tool prints in the results, like "threadId".
+     */
+    void print(size_t nr, const std::string& label) const {
+        if (!isEnabled()) return;
+        for (size_t i = 0; i < nr; i++) {
+            ::printf("%s %zu cpu %d node %d%s\n", label.c_str(), i, getCpu(i), getNode(i),
+                     isNumaBind ? " membind" : "");
+        }
+    }
+};
+
+/**
+ * Print CPU time of the submitter thread.
+ * @bgn CPU time at the beginning.
+ * @end CPU time at the end.
+ * @nio Number of IO executed.
+ */
+static inline
+void printCpuTime(const CpuTime& bgn, const CpuTime& end, size_t nio)
+{
+    const double user = end.user - bgn.user;
+    const double sys = end.sys - bgn.sys;
+    const double perIo = nio == 0 ? 0.0 : (user + sys) / static_cast<double>(nio);
+    ::printf("CPU: user %.3f s sys %.3f s %.3f us/IO.\n", user, sys, perIo * 1000000.0);
+}
+
 /**
  * Print zero throuhgput.
  */
@@ -624,6 +2690,32 @@ void printZeroThroughput()
     ::printf("Throughput: 0.0 B/s 0.0 B/sec 0.0 iops.\n");
 }
 
+/**
+ * Print statistics and throughput of each IO size.
+ * @stats indexed as bsSplit.sizes.
+ * @periodInSec Elapsed time [second].
+ * @return total size of the IOs [bytes].
+ */
+static inline
+uint64_t printSizeStats(const BsSplitConfig& bsSplit,
+                        const std::vector<PerformanceStatistics>& stats, double periodInSec)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < bsSplit.getNr(); i++) {
+        const size_t size = bsSplit.sizes[i];
+        ::printf("size %zu ", size);
+        stats[i].print();
+        ::printf("size %zu ", size);
+        if (periodInSec > 0) {
+            printThroughput(size, stats[i].getCount(), periodInSec);
+        } else {
+            printZeroThroughput();
+        }
+        total += size * stats[i].getCount();
+    }
+    return total;
+}
+
 /**
  * Ring buffer for block data.
  */
@@ -631,12 +2723,14 @@ class BlockBuffer
 {
 private:
     const size_t nr_;
+    const size_t blockSize_;
     std::vector<char *> bufArray_;
     size_t idx_;
 
 public:
     BlockBuffer(size_t nr, size_t blockSize)
         : nr_(nr)
+        , blockSize_(blockSize)
         , bufArray_(nr)
         , idx_(0) {
 
@@ -663,4 +2757,110 @@ public:
         idx_ = (idx_ + 1) % nr_;
         return ret;
     }
+
+    /**
+     * Get all the buffers to register them to an IO engine.
+     */
+    std::vector<struct iovec> getIovecs() const {
+
+        std::vector<struct iovec> iovs(nr_);
+        for (size_t i = 0; i < nr_; i++) {
+            iovs[i].iov_base = bufArray_[i];
+            iovs[i].iov_len = blockSize_;
+        }
+        return iovs;
+    }
+};
+
+/**
+ * Ring buffer of iovecs on separately allocated segments.
+ * Each entry is an IO split as VectorConfig.
+ */
+class IovecBuffer
+{
+private:
+    const size_t nr_;
+    const size_t blockSize_;
+    const VectorConfig cfg_;
+    std::vector<char *> segArray_; /* nr_ * nrSegs segments. */
+    std::vector<struct iovec> iovArray_; /* nr_ * nrSegs iovecs. */
+    std::vector<size_t> cuts_; /* split points in 512-byte units for random sizes. */
+    std::vector<size_t> sel_; /* temporal use for next(). */
+    Xoshiro256 rand_;
+    size_t idx_;
+
+public:
+    /**
+     * @gen generator of the split points for random sizes.
+     */
+    IovecBuffer(size_t nr, size_t blockSize, const VectorConfig& cfg, const Xoshiro256& gen)
+        : nr_(nr)
+        , blockSize_(blockSize)
+        , cfg_(cfg)
+        , segArray_()
+        , iovArray_(nr * cfg.nrSegs)
+        , cuts_()
+        , sel_()
+        , rand_(gen)
+        , idx_(0) {
+
+        const size_t nrSegs = cfg_.nrSegs;
+        for (size_t i = 0; i < nr_; i++) {
+            for (size_t j = 0; j < nrSegs; j++) {
+                const size_t size = cfg_.isRandom ?
+                    blockSize - (nrSegs - 1) * 512 : cfg_.sizes[j];
+                char *p = nullptr;
+                if (::posix_memalign((void **)&p, 4096, size) != 0) {
+                    throw std::runtime_error("posix_memalign failed");
+                }
+                segArray_.push_back(p);
+                iovArray_[i * nrSegs + j].iov_base = p;
+                iovArray_[i * nrSegs + j].iov_len = size;
+            }
+        }
+        if (cfg_.isRandom) {
+            for (size_t c = 1; c < blockSize / 512; c++) {
+                cuts_.push_back(c);
+            }
+        }
+    }
+
+    IovecBuffer(const IovecBuffer&) = delete;
+    IovecBuffer& operator=(const IovecBuffer&) = delete;
+
+    ~IovecBuffer() noexcept {
+
+        for (char *p : segArray_) {
+            ::free(p);
+        }
+    }
+
+    size_t getNrSegs() const { return cfg_.nrSegs; }
+
+    /**
+     * @return iovecs of the next entry, which has getNrSegs() items.
+     */
+    struct iovec* next() {
+
+        const size_t nrSegs = cfg_.nrSegs;
+        struct iovec *iov = &iovArray_[idx_ * nrSegs];
+        idx_ = (idx_ + 1) % nr_;
+        if (cfg_.isRandom) {
+            /* Choose nrSegs - 1 distinct split points by a partial shuffle. */
+            sel_.clear();
+            for (size_t i = 0; i + 1 < nrSegs; i++) {
+                const size_t j = i + rand_.get(cuts_.size() - i);
+                std::swap(cuts_[i], cuts_[j]);
+                sel_.push_back(cuts_[i]);
+            }
+            std::sort(sel_.begin(), sel_.end());
+            sel_.push_back(blockSize_ / 512);
+            size_t prev = 0;
+            for (size_t i = 0; i < nrSegs; i++) {
+                iov[i].iov_len = (sel_[i] - prev) * 512;
+                prev = sel_[i];
+            }
+        }
+        return iov;
+    }
 };